@@ -2,12 +2,15 @@
 
 #include <cmath>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "baseline.hpp"
 #include "dsas.hpp"
 #include "geometry.hpp"
 #include "grid.hpp"
+#include "rtree.hpp"
+#include "segment_batch.hpp"
 #include "shoreline.hpp"
 #include "transect.hpp"
 #include "utility.hpp"
@@ -38,11 +41,37 @@ std::vector<std::unique_ptr<dsas::Shoreline>> make_shorelines(
   return shorelines;
 }
 
+// Same layout as make_shorelines(), but alternating LiDAR-like shorelines
+// with 0.5 m vertices and digitised ones with 200 m vertices, so the median
+// segment length says little about most of the segments.
+std::vector<std::unique_ptr<dsas::Shoreline>> make_skewed_shorelines(
+    int num_shorelines, double x_max) {
+  std::vector<std::unique_ptr<dsas::Shoreline>> shorelines;
+  shorelines.reserve(num_shorelines);
+  const double y_spacing = 10.0;
+  const double y_center = (num_shorelines - 1) * y_spacing / 2.0;
+  for (int s = 0; s < num_shorelines; ++s) {
+    const double vertex_spacing = s % 2 == 0 ? 0.5 : 200.0;
+    const int points_per_line = static_cast<int>(x_max / vertex_spacing) + 1;
+    std::vector<dsas::Point> pts;
+    pts.reserve(points_per_line);
+    const double y_base = s * y_spacing - y_center;
+    for (int i = 0; i < points_per_line; ++i) {
+      const double x = i * vertex_spacing;
+      const double y = y_base + std::sin(x * 0.01) * 3.0;
+      pts.emplace_back(x, y);
+    }
+    dsas::Date date{2000 + s, 1, 1};
+    shorelines.push_back(std::make_unique<dsas::Shoreline>(pts, s, date));
+  }
+  return shorelines;
+}
+
 // Evenly spaced vertical transects, long enough to cross every shoreline
 // produced by make_shorelines() with the same num_shorelines.
-std::vector<std::unique_ptr<dsas::TransectLine>> make_transects(
-    int num_transects, int num_shorelines, double x_max) {
-  std::vector<std::unique_ptr<dsas::TransectLine>> transects;
+dsas::TransectTable make_transects(int num_transects, int num_shorelines,
+                                   double x_max) {
+  dsas::TransectTable transects;
   transects.reserve(num_transects);
   const double half_length = num_shorelines * 10.0 + 20.0;
   for (int i = 0; i < num_transects; ++i) {
@@ -50,8 +79,7 @@ std::vector<std::unique_ptr<dsas::TransectLine>> make_transects(
         x_max * static_cast<double>(i) / static_cast<double>(num_transects);
     dsas::Point start{x, -half_length};
     dsas::Point end{x, half_length};
-    transects.push_back(
-        std::make_unique<dsas::TransectLine>(start, end, i, /*baseline_id=*/0));
+    transects.push_back(dsas::TransectLine(start, end, i, /*baseline_id=*/0));
   }
   return transects;
 }
@@ -89,6 +117,82 @@ static void BM_LineSegmentFindIntersection(benchmark::State &state) {
 }
 BENCHMARK(BM_LineSegmentFindIntersection);
 
+// the three-step test intersect_segment replaces, and the query's one pass
+static void BM_TransectIntersectThreeStep(benchmark::State &state) {
+  dsas::TransectLine transect{{-5.0, 0.0}, {5.0, 0.0}, 0, 0};
+  dsas::Point p1{0.0, -5.0}, p2{1.0, 5.0};
+  for (auto _ : state) {
+    if (transect.is_intersect(p1, p2)) {
+      auto point = transect.find_intersection(p1, p2).value();
+      benchmark::DoNotOptimize(transect.distance2ref(point));
+    }
+  }
+}
+BENCHMARK(BM_TransectIntersectThreeStep);
+
+static void BM_TransectQuerySegment(benchmark::State &state) {
+  const auto query =
+      dsas::TransectLine{{-5.0, 0.0}, {5.0, 0.0}, 0, 0}.query();
+  dsas::Point p1{0.0, -5.0}, p2{1.0, 5.0};
+  for (auto _ : state) {
+    const auto crossing = dsas::intersect_segment(query.constants, p1, p2);
+    if (crossing.hit) {
+      benchmark::DoNotOptimize(
+          dsas::point_along(query.left(), query.right(), crossing.t));
+      benchmark::DoNotOptimize(query.offset_at(crossing.t));
+    }
+  }
+}
+BENCHMARK(BM_TransectQuerySegment);
+
+// 64 random segments against one transect: the pairwise reference loop and
+// the batched kernel (arg: BatchKernel, skipped when the CPU lacks it)
+static dsas::SegmentBatch make_segment_batch() {
+  dsas::SegmentBatch batch;
+  for (size_t k = 0; k < dsas::SegmentBatch::capacity; ++k) {
+    const double x = static_cast<double>(k);
+    batch.push({x, -5.0 + std::sin(x)}, {x + 1.0, 5.0 * std::cos(x)});
+  }
+  return batch;
+}
+
+static void BM_IntersectPairwise(benchmark::State &state) {
+  const auto batch = make_segment_batch();
+  const dsas::Point start{-1.0, 0.5}, end{65.0, -0.5};
+  for (auto _ : state) {
+    int num_hits = 0;
+    for (size_t k = 0; k < batch.size; ++k) {
+      const dsas::Point p{batch.x0[k], batch.y0[k]};
+      const dsas::Point q{batch.x1[k], batch.y1[k]};
+      if (isTwoSegmentIntersected(start, end, p, q)) {
+        dsas::Point point;
+        computeIntersectPoint(start, end, p, q, point);
+        benchmark::DoNotOptimize(point);
+        ++num_hits;
+      }
+    }
+    benchmark::DoNotOptimize(num_hits);
+  }
+}
+BENCHMARK(BM_IntersectPairwise);
+
+static void BM_IntersectBatch(benchmark::State &state) {
+  const auto kernel = static_cast<dsas::BatchKernel>(state.range(0));
+  if (!dsas::batch_kernel_supported(kernel)) {
+    state.SkipWithError("kernel not supported on this CPU");
+    return;
+  }
+  state.SetLabel(dsas::batch_kernel_name(kernel));
+  const auto batch = make_segment_batch();
+  const dsas::Point start{-1.0, 0.5}, end{65.0, -0.5};
+  dsas::BatchHits hits;
+  for (auto _ : state) {
+    dsas::intersect_batch(kernel, start, end, batch, hits);
+    benchmark::DoNotOptimize(hits);
+  }
+}
+BENCHMARK(BM_IntersectBatch)->DenseRange(0, 3);
+
 // ---------------------------------------------------------------------------
 // Regression used to compute shoreline change rate
 // ---------------------------------------------------------------------------
@@ -108,6 +212,49 @@ static void BM_LeastSquare(benchmark::State &state) {
 }
 BENCHMARK(BM_LeastSquare)->RangeMultiplier(4)->Range(8, 8 << 12)->Complexity();
 
+// ---------------------------------------------------------------------------
+// Shoreline date parsing over 64 repeated survey dates or 4096 distinct
+// ones (range 1): one-off generate_date_from_str calls, and a DateParser on
+// its hand-written path ("%Y/%m/%d") or on strptime ("%Y/%m/%e", range 0)
+// ---------------------------------------------------------------------------
+
+static std::vector<std::string> make_date_strings(bool distinct) {
+  std::vector<std::string> dates;
+  for (int i = 0; i < 4096; ++i) {
+    const int k = distinct ? i : i % 64;
+    dates.push_back(std::to_string(1990 + k / 336) + "/" +
+                    std::to_string(1 + k / 28 % 12) + "/" +
+                    std::to_string(1 + k % 28));
+  }
+  return dates;
+}
+
+static void BM_GenerateDateFromStr(benchmark::State &state) {
+  const auto dates = make_date_strings(state.range(1) != 0);
+  dsas::options.date_format = state.range(0) ? "%Y/%m/%e" : "%Y/%m/%d";
+  for (auto _ : state) {
+    for (const auto &date : dates) {
+      benchmark::DoNotOptimize(dsas::generate_date_from_str(date.c_str()));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<int64_t>(dates.size()));
+}
+BENCHMARK(BM_GenerateDateFromStr)->ArgsProduct({{0, 1}, {0, 1}});
+
+static void BM_DateParser(benchmark::State &state) {
+  const auto dates = make_date_strings(state.range(1) != 0);
+  for (auto _ : state) {
+    dsas::DateParser parser(state.range(0) ? "%Y/%m/%e" : "%Y/%m/%d");
+    for (const auto &date : dates) {
+      benchmark::DoNotOptimize(parser.parse(date));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<int64_t>(dates.size()));
+}
+BENCHMARK(BM_DateParser)->ArgsProduct({{0, 1}, {0, 1}});
+
 // ---------------------------------------------------------------------------
 // Spatial grid index construction
 // ---------------------------------------------------------------------------
@@ -116,7 +263,8 @@ static void BM_ComputeGridBound(benchmark::State &state) {
   const auto n = static_cast<int>(state.range(0));
   auto shorelines = make_shorelines(n, 200, 2000.0);
   for (auto _ : state) {
-    dsas::compute_grid_bound(shorelines);
+    auto bound = dsas::compute_grid_bound(shorelines);
+    benchmark::DoNotOptimize(bound);
   }
   state.SetComplexityN(n);
 }
@@ -125,9 +273,9 @@ BENCHMARK(BM_ComputeGridBound)->RangeMultiplier(4)->Range(1, 256)->Complexity();
 static void BM_BuildShorelineIndex(benchmark::State &state) {
   const auto n = static_cast<int>(state.range(0));
   auto shorelines = make_shorelines(n, 200, 2000.0);
-  dsas::compute_grid_bound(shorelines);
+  const auto bound = dsas::compute_grid_bound(shorelines);
   for (auto _ : state) {
-    auto grids = dsas::build_shoreline_index(shorelines);
+    auto grids = dsas::build_shoreline_index(shorelines, bound);
     benchmark::DoNotOptimize(grids);
   }
   state.SetComplexityN(n);
@@ -140,12 +288,12 @@ BENCHMARK(BM_BuildShorelineIndex)
 static void BM_BuildTransectIndex(benchmark::State &state) {
   const auto n = static_cast<int>(state.range(0));
   auto shorelines = make_shorelines(4, 200, 2000.0);
-  dsas::compute_grid_bound(shorelines);
+  const auto bound = dsas::compute_grid_bound(shorelines);
   for (auto _ : state) {
     state.PauseTiming();
     auto transects = make_transects(n, 4, 2000.0);
     state.ResumeTiming();
-    dsas::build_transect_index(transects);
+    dsas::build_transect_index(transects, bound);
     benchmark::DoNotOptimize(transects);
   }
   state.SetComplexityN(n);
@@ -155,6 +303,39 @@ BENCHMARK(BM_BuildTransectIndex)
     ->Range(8, 8 << 10)
     ->Complexity();
 
+static void BM_BuildShorelineRTree(benchmark::State &state) {
+  const auto n = static_cast<int>(state.range(0));
+  auto shorelines = make_shorelines(n, 200, 2000.0);
+  for (auto _ : state) {
+    auto rtree = dsas::build_shoreline_rtree(shorelines);
+    benchmark::DoNotOptimize(rtree);
+  }
+  state.SetComplexityN(n);
+}
+BENCHMARK(BM_BuildShorelineRTree)
+    ->RangeMultiplier(4)
+    ->Range(1, 256)
+    ->Complexity();
+
+// Diagonal transect of growing length on a fixed 10 m grid: the line walk
+// should scale with the length, not with the area of the transect's bbox.
+static void BM_TraverseGridDiagonal(benchmark::State &state) {
+  const double length = static_cast<double>(state.range(0));
+  const auto bound = dsas::make_grid_bound(0.0, 0.0, 10000.0, 10000.0, 10.0);
+  const double d = length / std::sqrt(2.0);
+  dsas::Point a{5.0, 5.0}, b{5.0 + d, 5.0 + d};
+  for (auto _ : state) {
+    size_t cells = 0;
+    dsas::traverse_grid(bound, a, b, [&](int, int) { cells++; });
+    benchmark::DoNotOptimize(cells);
+  }
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_TraverseGridDiagonal)
+    ->RangeMultiplier(4)
+    ->Range(64, 64 << 6)
+    ->Complexity();
+
 // ---------------------------------------------------------------------------
 // End-to-end intersection pipeline: grid-accelerated vs. brute force.
 // The grid index exists to avoid the O(transects * shorelines) scan, so the
@@ -198,3 +379,65 @@ static void BM_BruteForceIntersectionPipeline(benchmark::State &state) {
   }
 }
 BENCHMARK(BM_BruteForceIntersectionPipeline)->Args({5, 50})->Args({20, 200});
+
+static void BM_RTreeIntersectionPipeline(benchmark::State &state) {
+  const int num_shorelines = static_cast<int>(state.range(0));
+  const int num_transects = static_cast<int>(state.range(1));
+  constexpr double x_max = 2000.0;
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto shorelines = make_shorelines(num_shorelines, 200, x_max);
+    auto transects = make_transects(num_transects, num_shorelines, x_max);
+    state.ResumeTiming();
+
+    auto rtree = dsas::build_shoreline_rtree(shorelines);
+    auto intersects = dsas::generate_intersects(transects, rtree);
+    benchmark::DoNotOptimize(intersects);
+  }
+}
+BENCHMARK(BM_RTreeIntersectionPipeline)
+    ->Args({5, 50})
+    ->Args({20, 200})
+    ->Args({50, 500});
+
+// ---------------------------------------------------------------------------
+// Skewed segment lengths: the grid is sized by the median segment, so the
+// long digitised segments span many cells; the R-tree stores each once.
+// ---------------------------------------------------------------------------
+
+static void BM_GridIntersectionSkewed(benchmark::State &state) {
+  const int num_shorelines = static_cast<int>(state.range(0));
+  const int num_transects = static_cast<int>(state.range(1));
+  constexpr double x_max = 2000.0;
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto shorelines = make_skewed_shorelines(num_shorelines, x_max);
+    auto transects = make_transects(num_transects, num_shorelines, x_max);
+    state.ResumeTiming();
+
+    auto grids = dsas::build_spatial_grids(shorelines, transects);
+    auto intersects = dsas::generate_intersects(transects, grids);
+    benchmark::DoNotOptimize(intersects);
+  }
+}
+BENCHMARK(BM_GridIntersectionSkewed)->Args({4, 100})->Args({16, 400});
+
+static void BM_RTreeIntersectionSkewed(benchmark::State &state) {
+  const int num_shorelines = static_cast<int>(state.range(0));
+  const int num_transects = static_cast<int>(state.range(1));
+  constexpr double x_max = 2000.0;
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto shorelines = make_skewed_shorelines(num_shorelines, x_max);
+    auto transects = make_transects(num_transects, num_shorelines, x_max);
+    state.ResumeTiming();
+
+    auto rtree = dsas::build_shoreline_rtree(shorelines);
+    auto intersects = dsas::generate_intersects(transects, rtree);
+    benchmark::DoNotOptimize(intersects);
+  }
+}
+BENCHMARK(BM_RTreeIntersectionSkewed)->Args({4, 100})->Args({16, 400});
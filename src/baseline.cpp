@@ -4,11 +4,12 @@
 
 #include <algorithm>
 #include <cassert>
-#include <fstream>
 #include <iostream>
-#include <nlohmann/json.hpp>
 
 #include "exception.hpp"
+#include "geojson.hpp"
+#include "shapefile.hpp"
+#include "utility.hpp"
 
 namespace dsas {
 
@@ -89,137 +90,82 @@ Baseline::Baseline(const std::vector<BaselinesVertex> &points, int baseline_id)
 // ---- GeoJSON reader ----
 
 static std::vector<Baseline> load_baselines_geojson(
-    const std::filesystem::path &path, const std::string &id_field) {
-  std::ifstream f(path);
-  if (!f) OPENDSAS_THROW("Cannot open: " + path.string());
-  auto j = nlohmann::json::parse(f);
-
-  // Validate requested id_field exists in the first feature (if specified)
-  if (!id_field.empty() && !j["features"].empty()) {
-    const auto &props = j["features"][0]["properties"];
-    bool found = false;
-    for (auto &[k, v] : props.items()) {
-      if (k == id_field) {
-        found = true;
-        break;
-      }
-    }
-    if (!found) {
-      OPENDSAS_THROW("Field '" + id_field +
-                     "' not found in baseline shapefile.");
-    }
-  }
-
+    const std::filesystem::path &path, const std::string &id_field,
+    std::string *prj) {
   std::vector<Baseline> baselines;
   int auto_id = 0;
 
-  for (auto &feature : j["features"]) {
+  auto read_feature = [&](const GeoJsonFeature &feature) {
     int baseline_id = auto_id;
     if (!id_field.empty()) {
-      baseline_id = feature["properties"][id_field].get<int>();
+      const auto *id = feature.property(id_field);
+      if (!id) {
+        OPENDSAS_THROW("Field '" + id_field +
+                       "' not found in baseline shapefile.");
+      }
+      baseline_id = id->get<int>();
     }
 
-    auto &geom = feature["geometry"];
-    std::string gtype = geom["type"].get<std::string>();
-
-    auto read_line = [&](const nlohmann::json &coords) {
-      std::vector<Point> pts;
-      pts.reserve(coords.size());
-      for (auto &c : coords) {
-        pts.emplace_back(c[0].get<double>(), c[1].get<double>());
-      }
-      return pts;
-    };
-
-    if (gtype == "LineString") {
-      baselines.emplace_back(read_line(geom["coordinates"]), baseline_id);
-    } else if (gtype == "MultiLineString") {
-      for (auto &line : geom["coordinates"]) {
-        baselines.emplace_back(read_line(line), baseline_id);
+    const auto &gtype = feature.geometry_type;
+    if (gtype == "LineString" || gtype == "MultiLineString") {
+      for (size_t k = 0; k < feature.num_parts(); ++k) {
+        const auto line = feature.part(k);
+        baselines.emplace_back(std::vector<Point>(line.begin(), line.end()),
+                               baseline_id);
       }
     } else {
       std::cout << "Unsupported geometry type: " << gtype << "\n";
-      ++auto_id;
-      continue;
     }
     ++auto_id;
-  }
+  };
+  GeoJsonCrs crs;
+  read_geojson_features(path, read_feature, &crs);
+  if (prj) *prj = crs.projection(path);
   return baselines;
 }
 
 // ---- Shapefile reader ----
 
-// GCOVR_EXCL_START
-static std::vector<Baseline> load_baselines_shapelib(
+static std::vector<Baseline> load_baselines_shapefile(
     const std::filesystem::path &path, const std::string &id_field) {
-  const std::string base = path.stem().string();
-  const std::string dir = path.parent_path().string();
-  std::string base_path = dir.empty() ? base : dir + "/" + base;
-
-  SHPHandle hSHP = SHPOpen(base_path.c_str(), "rb");
-  if (!hSHP) OPENDSAS_THROW("Cannot open shapefile: " + path.string());
-  DBFHandle hDBF = DBFOpen(base_path.c_str(), "rb");
-  if (!hDBF) {
-    SHPClose(hSHP);
-    OPENDSAS_THROW("Cannot open DBF: " + path.string());
-  }
-
+  ShapefileReader shapefile(path);
   int id_field_idx = -1;
   if (!id_field.empty()) {
-    id_field_idx = DBFGetFieldIndex(hDBF, id_field.c_str());
+    id_field_idx = shapefile.field_index(id_field);
     if (id_field_idx < 0) {
-      SHPClose(hSHP);
-      DBFClose(hDBF);
       OPENDSAS_THROW("Field '" + id_field +
                      "' not found in baseline shapefile.");
     }
   }
 
-  int n_entities = 0;
-  SHPGetInfo(hSHP, &n_entities, nullptr, nullptr, nullptr);
-
-  std::vector<Baseline> baselines;
-  for (int i = 0; i < n_entities; ++i) {
-    int baseline_id = i;
-    if (id_field_idx >= 0) {
-      baseline_id = DBFReadIntegerAttribute(hDBF, i, id_field_idx);
-    }
-    SHPObject *obj = SHPReadObject(hSHP, i);
-    if (!obj) continue;
-
-    if (obj->nSHPType == SHPT_ARC || obj->nSHPType == SHPT_ARCZ) {
-      for (int p = 0; p < obj->nParts; ++p) {
-        int start = obj->panPartStart[p];
-        int end =
-            (p + 1 < obj->nParts) ? obj->panPartStart[p + 1] : obj->nVertices;
-        std::vector<Point> pts;
-        pts.reserve(static_cast<size_t>(end - start));
-        for (int k = start; k < end; ++k) {
-          pts.emplace_back(obj->padfX[k], obj->padfY[k]);
+  return read_records<Baseline>(
+      shapefile, [&](size_t i, const ShapeRecord &record, auto &out) {
+        int baseline_id = static_cast<int>(i);
+        if (id_field_idx >= 0) {
+          baseline_id = shapefile.integer_attribute(i, id_field_idx);
         }
-        baselines.emplace_back(pts, baseline_id);
-      }
-    }
-    SHPDestroyObject(obj);
-  }
-
-  SHPClose(hSHP);
-  DBFClose(hDBF);
-  return baselines;
+        if (record.shape_type != SHPT_ARC && record.shape_type != SHPT_ARCZ) {
+          return;
+        }
+        for (size_t p = 0; p < record.num_parts(); ++p) {
+          const auto line = record.part(p);
+          out.emplace_back(std::vector<Point>(line.begin(), line.end()),
+                           baseline_id);
+        }
+      });
 }
-// GCOVR_EXCL_STOP
 
 // ---- Public dispatch ----
 
 std::vector<Baseline> load_baselines_shp(
     const std::filesystem::path &baseline_shp_path,
-    const std::string &baseline_id_field) {
+    const std::string &baseline_id_field, std::string *prj) {
   auto ext = baseline_shp_path.extension().string();
   if (ext == ".geojson" || ext == ".json") {
-    return load_baselines_geojson(baseline_shp_path, baseline_id_field);
+    return load_baselines_geojson(baseline_shp_path, baseline_id_field, prj);
   }
-  return load_baselines_shapelib(baseline_shp_path,
-                                 baseline_id_field);  // GCOVR_EXCL_LINE
+  if (prj) *prj = get_shp_proj(baseline_shp_path.string().c_str());
+  return load_baselines_shapefile(baseline_shp_path, baseline_id_field);
 }
 
 }  // namespace dsas
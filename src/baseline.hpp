@@ -34,9 +34,11 @@ struct Baseline {
   Baseline(const std::vector<BaselinesVertex> &points, int baseline_id);
 };
 
+// Loads the baselines of a shapefile or GeoJSON file. If prj is given, the
+// file's projection (see get_shp_proj) is read into it in the same pass.
 std::vector<Baseline> load_baselines_shp(
     const std::filesystem::path &baseline_shp_path,
-    const std::string &baseline_id_field = "");
+    const std::string &baseline_id_field = "", std::string *prj = nullptr);
 }  // namespace dsas
 
 #endif
\ No newline at end of file
@@ -52,6 +52,18 @@ dsas::Options::TransectOrientation parse_transect_orient(const std::string& s) {
   if (s == "mix") return dsas::Options::TransectOrientation::Mix;
   OPENDSAS_THROW("Invalid --transect-orientation: " + s);
 }
+
+dsas::Options::SpatialIndex parse_spatial_index(const std::string& s) {
+  if (s == "grid") return dsas::Options::SpatialIndex::Grid;
+  if (s == "rtree") return dsas::Options::SpatialIndex::RTree;
+  OPENDSAS_THROW("Invalid --index: " + s);
+}
+
+dsas::Options::GridSizing parse_grid_sizing(const std::string& s) {
+  if (s == "median") return dsas::Options::GridSizing::Median;
+  if (s == "cost") return dsas::Options::GridSizing::CostModel;
+  OPENDSAS_THROW("Invalid --grid-sizing: " + s);
+}
 void init_root_cmd(argparse::ArgumentParser& root_cmd) {
   root_cmd.add_argument("--baseline")
       .help("Path to the baseline file")
@@ -106,6 +118,20 @@ void init_root_cmd(argparse::ArgumentParser& root_cmd) {
       .default_value(false)
       .implicit_value(true)
       .help("Build spatial index to speed up search");
+  root_cmd.add_argument("--index")
+      .default_value(std::string("grid"))
+      .help("Spatial index used with -bi: grid or rtree (implies -bi)");
+  root_cmd.add_argument("--grid-sizing")
+      .default_value(std::string("median"))
+      .help("Grid cell size: median segment length or cost model (cost)");
+  root_cmd.add_argument("--thread-stats")
+      .default_value(false)
+      .implicit_value(true)
+      .help("Print the busy time of each thread in the parallel loops");
+  root_cmd.add_argument("--no-intersects")
+      .default_value(false)
+      .implicit_value(true)
+      .help("Compute the change rates only, without writing intersections");
 }
 
 void init_cast_cmd(argparse::ArgumentParser& cast_cmd) {
@@ -168,6 +194,20 @@ void init_cal_cmd(argparse::ArgumentParser& cal_cmd) {
       .default_value(false)
       .implicit_value(true)
       .help("Build spatial index to speed up search");
+  cal_cmd.add_argument("--index")
+      .default_value(std::string("grid"))
+      .help("Spatial index used with -bi: grid or rtree (implies -bi)");
+  cal_cmd.add_argument("--grid-sizing")
+      .default_value(std::string("median"))
+      .help("Grid cell size: median segment length or cost model (cost)");
+  cal_cmd.add_argument("--thread-stats")
+      .default_value(false)
+      .implicit_value(true)
+      .help("Print the busy time of each thread in the parallel loops");
+  cal_cmd.add_argument("--no-intersects")
+      .default_value(false)
+      .implicit_value(true)
+      .help("Compute the change rates only, without writing intersections");
 }
 }  // namespace
 
@@ -223,7 +263,14 @@ CliStatus parse_args(int argc, char* argv[]) {
           cal_cmd.get<std::string>("--transect-orientation"));
       dsas::options.intersect_path =
           cal_cmd.get<std::string>("--output-intersect");
-      dsas::options.build_index = cal_cmd.get<bool>("--build_index");
+      dsas::options.build_index =
+          cal_cmd.get<bool>("--build_index") || cal_cmd.is_used("--index");
+      dsas::options.spatial_index =
+          parse_spatial_index(cal_cmd.get<std::string>("--index"));
+      dsas::options.grid_sizing =
+          parse_grid_sizing(cal_cmd.get<std::string>("--grid-sizing"));
+      dsas::options.thread_stats = cal_cmd.get<bool>("--thread-stats");
+      dsas::options.write_intersects = !cal_cmd.get<bool>("--no-intersects");
       check_format_consistency({
           {"--shoreline", dsas::options.shoreline_path},
           {"--transect", dsas::options.transect_path},
@@ -251,7 +298,14 @@ CliStatus parse_args(int argc, char* argv[]) {
         root_cmd.get<std::string>("--intersection-mode"));
     dsas::options.transect_orient = parse_transect_orient(
         root_cmd.get<std::string>("--transect-orientation"));
-    dsas::options.build_index = root_cmd.get<bool>("--build_index");
+    dsas::options.build_index =
+        root_cmd.get<bool>("--build_index") || root_cmd.is_used("--index");
+    dsas::options.spatial_index =
+        parse_spatial_index(root_cmd.get<std::string>("--index"));
+    dsas::options.grid_sizing =
+        parse_grid_sizing(root_cmd.get<std::string>("--grid-sizing"));
+    dsas::options.thread_stats = root_cmd.get<bool>("--thread-stats");
+    dsas::options.write_intersects = !root_cmd.get<bool>("--no-intersects");
     check_format_consistency({
         {"--baseline", dsas::options.baseline_path},
         {"--shoreline", dsas::options.shoreline_path},
@@ -0,0 +1,25 @@
+#include "diagnostics.hpp"
+
+#include <ostream>
+
+namespace dsas {
+
+Diagnostics diagnostics;
+
+void Diagnostics::reset() {
+  exact_orientations = 0;
+  parallel_segments = 0;
+}
+
+bool Diagnostics::empty() const {
+  return exact_orientations == 0 && parallel_segments == 0;
+}
+
+std::ostream &operator<<(std::ostream &os, const Diagnostics &diagnostics) {
+  os << "Degenerate geometry: " << diagnostics.parallel_segments
+     << " (nearly) parallel segment pairs, " << diagnostics.exact_orientations
+     << " orientations resolved exactly";
+  return os;
+}
+
+}  // namespace dsas
@@ -0,0 +1,29 @@
+#ifndef SRC_DIAGNOSTICS_HPP_
+#define SRC_DIAGNOSTICS_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+
+namespace dsas {
+
+// Counts of the degenerate geometry the intersection code met, updated from
+// the parallel loops instead of logging each case.
+struct Diagnostics {
+  // orientation signs settled by exact arithmetic (orient2d_exact)
+  std::atomic<std::uint64_t> exact_orientations{0};
+  // segment pairs whose lines are (nearly) parallel, so there was no
+  // line-line solve and the overlap midpoint stood in for the crossing
+  std::atomic<std::uint64_t> parallel_segments{0};
+
+  void reset();
+  [[nodiscard]] bool empty() const;
+};
+
+extern Diagnostics diagnostics;
+
+// One line summary, e.g. for the end of a run.
+std::ostream &operator<<(std::ostream &os, const Diagnostics &diagnostics);
+
+}  // namespace dsas
+#endif
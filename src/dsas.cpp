@@ -1,160 +1,312 @@
 #include "dsas.hpp"
 
+#include <omp.h>
+
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 
 #include "exception.hpp"
 #include "grid.hpp"
 #include "intersect.hpp"
 #include "options.hpp"
+#include "rtree.hpp"
+#include "schedule.hpp"
 #include "utility.hpp"
 namespace dsas {
 
-std::vector<std::unique_ptr<TransectLine>> generate_transects(
-    std::vector<Baseline> &baselines) {
-  std::vector<std::unique_ptr<TransectLine>> transects;
+TransectTable generate_transects(std::vector<Baseline> &baselines) {
+  TransectTable transects;
   for (auto &baseline : baselines) {
-    auto transect_lines = create_transects_from_baseline(baseline);
-    transects.insert(transects.end(),
-                     std::make_move_iterator(transect_lines.begin()),
-                     std::make_move_iterator(transect_lines.end()));
+    create_transects_from_baseline(baseline, transects);
   }
   return transects;
 }
 
-std::vector<std::unique_ptr<IntersectPoint>> generate_intersects(
-    std::vector<std::unique_ptr<TransectLine>> &transects,
-    const std::vector<std::unique_ptr<Shoreline>> &shorelines) {
-  using Pending = std::pair<size_t, std::unique_ptr<IntersectPoint>>;
-  std::vector<std::unique_ptr<IntersectPoint>> intersects;
-  std::vector<Pending> all_pending;
-#pragma omp parallel
-  {
-    std::vector<Pending> local;
-
-#pragma omp for schedule(static)
-    for (std::int64_t i = 0; i < transects.size(); i++) {
-      for (std::int64_t j = 0; j < shorelines.size(); j++) {
-        auto ret = transects[i]->intersection(*shorelines[j]);
-        if (ret.has_value()) {
-          auto up = std::make_unique<IntersectPoint>(*ret);
-          local.emplace_back(static_cast<size_t>(i), std::move(up));
-        }
-      }
+namespace {
+// Intersection searches over one kind of shoreline source: cost(transect)
+// estimates a transect's work for the scheduler, find(transect, out,
+// scratch) appends its intersections, one per shoreline, to out.
+struct BruteForceSearch {
+  const std::vector<std::unique_ptr<Shoreline>> &shorelines;
+
+  // shorelines whose envelope the transect's box overlaps
+  [[nodiscard]] double cost(const TransectQuery &transect) const {
+    const auto &c = transect.constants;
+    const Envelope box{c.min_x, c.min_y, c.max_x, c.max_y};
+    return static_cast<double>(std::count_if(
+        shorelines.begin(), shorelines.end(),
+        [&](const auto &s) { return s->envelope_.intersects(box); }));
+  }
+  void find(const TransectQuery &transect, IntersectTable &out,
+            IndexQueryScratch & /*scratch*/) const {
+    for (const auto &shoreline : shorelines) {
+      auto ret = transect.intersection(*shoreline);
+      if (ret.has_value()) out.push_back(*ret);
     }
-#pragma omp critical
-    {
-      // move-append local -> all_pending
-      all_pending.insert(all_pending.end(),
-                         std::make_move_iterator(local.begin()),
-                         std::make_move_iterator(local.end()));
+  }
+};
+
+struct GridSearch {
+  const Grids &grids;
+
+  // segments in the stored cells, or else cells the transect crosses
+  [[nodiscard]] double cost(const TransectQuery &transect) const {
+    if (transect.cells.empty() || *transect.cells_bound != grids.bound) {
+      return transect.length / grids.bound.grid_size;
     }
+    double segments = 0;
+    for (auto [i, j] : transect.cells) {
+      segments += static_cast<double>(grids.cell(i, j).size());
+    }
+    return segments;
+  }
+  void find(const TransectQuery &transect, IntersectTable &out,
+            IndexQueryScratch &scratch) const {
+    transect.intersection(grids, out, scratch);
   }
+};
 
-  intersects.reserve(all_pending.size());  // optional; avoids a few reallocs
-  for (auto &p : all_pending) {
-    intersects.push_back(std::move(p.second));  // move unique_ptr in
-    TransectLine *t = transects[p.first].get();
-    t->intersects.push_back(
-        intersects.back().get());  // raw pointer to heap object (stable)
+struct RTreeSearch {
+  const RTree &rtree;
+
+  // the nodes a query visits grow with the transect length
+  [[nodiscard]] double cost(const TransectQuery &transect) const {
+    return transect.length;
+  }
+  void find(const TransectQuery &transect, IntersectTable &out,
+            IndexQueryScratch &scratch) const {
+    transect.intersection(rtree, out, scratch);
+  }
+};
+
+// Runs the search for every transect in parallel, balanced by its estimated
+// cost, each thread appending rows to its own table, then merges the thread
+// tables in transect order: the rows are counted per transect, the counts
+// turned into offsets and the rows copied to their place in the pre-sized
+// table. The output is the same for any thread count and timing.
+template <typename Search>
+IntersectTable collect_intersect_table(TransectTable &transects,
+                                      const Search &search,
+                                      LoopBalance *balance) {
+  const size_t n = transects.size();
+  std::vector<IntersectTable> locals(omp_get_max_threads());
+  std::vector<IndexQueryScratch> scratches(locals.size());
+  std::vector<int> owner(n);           // thread that found transect i
+  std::vector<size_t> local_first(n);  // its first row in that thread's table
+  // rows of transect i go to [offsets[i], offsets[i + 1])
+  std::vector<size_t> offsets(n + 1, 0);
+  FirstError first_error(n);
+  for_each_balanced(
+      n, [&](size_t i) { return search.cost(transects.query(i)); },
+      [&](size_t i, int thread) {
+        auto &local = locals[thread];
+        owner[i] = thread;
+        local_first[i] = local.size();
+        try {
+          search.find(transects.query(i), local, scratches[thread]);
+        } catch (...) {
+          first_error.capture(i);
+        }
+        offsets[i + 1] = local.size() - local_first[i];
+      },
+      balance);
+  first_error.rethrow();
+  for (size_t i = 0; i < n; i++) offsets[i + 1] += offsets[i];
+
+  IntersectTable intersects;
+  intersects.resize(offsets.back());
+  const auto total = static_cast<std::int64_t>(n);
+#pragma omp parallel for schedule(static)
+  for (std::int64_t i = 0; i < total; i++) {
+    const size_t count = offsets[i + 1] - offsets[i];
+    intersects.copy_rows(offsets[i], locals[owner[i]], local_first[i], count);
+    transects.intersects[i] =
+        count > 0 ? IntersectRange{offsets[i], count} : IntersectRange{};
   }
   return intersects;
 }
 
-std::vector<std::unique_ptr<IntersectPoint>> generate_intersects(
-    std::vector<std::unique_ptr<TransectLine>> &transects, const Grids &grids) {
-  std::vector<std::unique_ptr<IntersectPoint>> intersects;
-#pragma omp parallel
-  {
-    std::vector<std::unique_ptr<IntersectPoint>> local;
-
-#pragma omp for schedule(static)
-    for (std::int64_t i = 0; i < transects.size(); i++) {
-      auto tmp_intersects = transects[i]->intersection(grids);
-      if (!tmp_intersects.empty()) {
-        for (auto &intersect : tmp_intersects) {
-          transects[i]->intersects.push_back(intersect.get());
-          local.push_back(std::move(intersect));
+// Runs the search for every transect in parallel into a per-thread scratch
+// table and turns it into the transect's change rate right away, so only
+// one transect's intersections per thread are alive at a time. The tables
+// are freed on return.
+template <typename Search>
+void compute_rates(TransectTable &transects, const Search &search,
+                   LoopBalance *balance) {
+  const size_t n = transects.size();
+  std::vector<IntersectTable> scratches(omp_get_max_threads());
+  std::vector<IndexQueryScratch> query_scratches(scratches.size());
+  std::vector<RateScratch> rate_scratches(scratches.size());
+  FirstError first_error(n);
+  for_each_balanced(
+      n, [&](size_t i) { return search.cost(transects.query(i)); },
+      [&](size_t i, int thread) {
+        auto &scratch = scratches[thread];
+        scratch.clear();
+        transects.intersects[i] = {};
+        try {
+          search.find(transects.query(i), scratch, query_scratches[thread]);
+          if (!scratch.empty()) {
+            transects.change_rate[i] = linearRegressRate(
+                scratch, {0, scratch.size()}, rate_scratches[thread]);
+          }
+        } catch (...) {
+          first_error.capture(i);
         }
-      }
-    }
-#pragma omp critical
-    {
-      // move-append local -> all_pending
-      intersects.insert(intersects.end(),
-                        std::make_move_iterator(local.begin()),
-                        std::make_move_iterator(local.end()));
-    }
-  }
+      },
+      balance);
+  first_error.rethrow();
+}
+}  // namespace
 
-  return intersects;
+IntersectTable generate_intersects(
+    TransectTable &transects,
+    const std::vector<std::unique_ptr<Shoreline>> &shorelines,
+    LoopBalance *balance) {
+  return collect_intersect_table(transects, BruteForceSearch{shorelines},
+                                 balance);
+}
+
+IntersectTable generate_intersects(TransectTable &transects,
+                                   const Grids &grids, LoopBalance *balance) {
+  return collect_intersect_table(transects, GridSearch{grids}, balance);
+}
+
+IntersectTable generate_intersects(TransectTable &transects,
+                                   const RTree &rtree, LoopBalance *balance) {
+  return collect_intersect_table(transects, RTreeSearch{rtree}, balance);
+}
+
+void generate_rates(TransectTable &transects,
+                    const std::vector<std::unique_ptr<Shoreline>> &shorelines,
+                    LoopBalance *balance) {
+  compute_rates(transects, BruteForceSearch{shorelines}, balance);
+}
+
+void generate_rates(TransectTable &transects, const Grids &grids,
+                    LoopBalance *balance) {
+  compute_rates(transects, GridSearch{grids}, balance);
+}
+
+void generate_rates(TransectTable &transects, const RTree &rtree,
+                    LoopBalance *balance) {
+  compute_rates(transects, RTreeSearch{rtree}, balance);
+}
+
+void set_change_rates(TransectTable &transects,
+                      const IntersectTable &intersects,
+                      LoopBalance *balance) {
+  const size_t n = transects.size();
+  std::vector<RateScratch> scratches(omp_get_max_threads());
+  FirstError first_error(n);
+  // cost: the sort in linearRegressRate dominates
+  for_each_balanced(
+      n,
+      [&](size_t i) {
+        return static_cast<double>(transects.intersects[i].size());
+      },
+      [&](size_t i, int thread) {
+        if (transects.intersects[i].empty()) return;
+        try {
+          transects.change_rate[i] = linearRegressRate(
+              intersects, transects.intersects[i], scratches[thread]);
+        } catch (...) {
+          first_error.capture(i);
+        }
+      },
+      balance);
+  first_error.rethrow();
 }
 
 Grids build_spatial_grids(
     const std::vector<std::unique_ptr<Shoreline>> &shorelines,
-    std::vector<std::unique_ptr<TransectLine>> &transects) {
-  compute_grid_bound(shorelines);
-  auto grids = build_shoreline_index(shorelines);
-  build_transect_index(transects);
+    TransectTable &transects, bool store_transect_cells,
+    LoopBalance *balance) {
+  GridBound bound;
+  if (options.grid_sizing == Options::GridSizing::CostModel) {
+    double transect_length = 0;
+    for (size_t i = 0; i < transects.size(); i++) {
+      transect_length +=
+          transects[i].left_edge().distance_to_point(transects[i].right_edge());
+    }
+    if (!transects.empty()) transect_length /= transects.size();
+    bound = compute_grid_bound_for_transects(shorelines, transect_length);
+  } else {
+    bound = compute_grid_bound(shorelines);
+  }
+  auto grids = build_shoreline_index(shorelines, bound);
+  // without stored cells each transect walks the grid while it is queried
+  if (store_transect_cells) {
+    build_transect_index(transects, bound, balance);
+  }
   return grids;
 }
-double linearRegressRate(std::vector<IntersectPoint *> &intersections) {
+double linearRegressRate(const IntersectTable &intersects,
+                         IntersectRange range, RateScratch &scratch) {
   // if no intersection
-  if (intersections.empty()) {
+  if (range.empty()) {
     OPENDSAS_THROW("Intersections should not be empty\n");
   }
 
   // if only one intersection
-  if (intersections.size() == 1) {
+  if (range.size() == 1) {
     return 0;
   }
 
-  //  sort the vector
-  std::sort(intersections.begin(), intersections.end(),
-            [](const IntersectPoint *a, const IntersectPoint *b) {
-              return a->date_ < b->date_ ||
-                     (a->date_ == b->date_ &&
-                      a->distance_to_ref_ < b->distance_to_ref_);
-            });
+  // sort the rows by date, then distance. Dates are told apart as parsed
+  // (packed), as a day 0 or a day past the month's end can share its day
+  // number with another date.
+  using Row = RateScratch::Row;
+  auto &rows = scratch.rows;
+  auto &x = scratch.x;
+  auto &y = scratch.y;
+  rows.clear();
+  for (size_t i = range.first; i < range.first + range.count; ++i) {
+    rows.push_back({intersects.ymd[i], intersects.day[i],
+                    intersects.distance[i]});
+  }
+  std::sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) {
+    return a.date < b.date || (a.date == b.date && a.distance < b.distance);
+  });
 
   // if two intersections
-  if (intersections.size() == 2) {
-    if (intersections[1]->date_ == intersections[0]->date_) {
+  if (rows.size() == 2) {
+    if (rows[1].date == rows[0].date) {
       OPENDSAS_THROW(
           "Error: Two intersection points have the same date, cannot compute "
           "change rate.");
     }
-    double d_distance =
-        intersections[1]->distance_to_ref_ - intersections[0]->distance_to_ref_;
-    double d_year =
-        days_between(intersections[1]->date_, intersections[0]->date_) / 365.0;
+    double d_distance = rows[1].distance - rows[0].distance;
+    double d_year = (rows[1].day - rows[0].day) / 365.0;
     return d_distance / d_year;
   }
 
   // change rate
-  std::vector<double> y;
-  std::vector<long long> x;
-  y.push_back(intersections[0]->distance_to_ref_);
-  x.push_back(intersections[0]->date_.julian_day());
-  for (size_t i = 1; i < intersections.size(); ++i) {
+  x.clear();
+  y.clear();
+  y.push_back(rows[0].distance);
+  x.push_back(rows[0].day);
+  for (size_t i = 1; i < rows.size(); ++i) {
     // if two intersections have the same date
-    if (intersections[i]->date_ == intersections[i - 1]->date_) {
+    if (rows[i].date == rows[i - 1].date) {
       if (dsas::options.intersection_mode ==
           dsas::Options::IntersectionMode::Closest) {
         // keep the closest one
         continue;
       }
       // keep the farthest one
-      y.back() = intersections[i]->distance_to_ref_;
+      y.back() = rows[i].distance;
       continue;
     }
-    x.push_back(intersections[i]->date_.julian_day());
-    y.push_back(intersections[i]->distance_to_ref_);
+    x.push_back(rows[i].day);
+    y.push_back(rows[i].distance);
   }
-  double change_rate_in_day = least_square(x, y);
+  double change_rate_in_day = least_square(x.data(), y.data(), x.size());
   double change_rate_yr = change_rate_in_day * 365.25;
   return change_rate_yr;
 }
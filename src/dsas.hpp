@@ -1,30 +1,82 @@
 #ifndef SRC_DSAS_HPP_
 #define SRC_DSAS_HPP_
 
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 #include "baseline.hpp"
 #include "grid.hpp"
 #include "intersect.hpp"
+#include "rtree.hpp"
+#include "schedule.hpp"
 #include "shoreline.hpp"
 #include "transect.hpp"
 
 namespace dsas {
 
-std::vector<std::unique_ptr<TransectLine>> generate_transects(
-    std::vector<Baseline> &);
+TransectTable generate_transects(std::vector<Baseline> &);
 
-std::vector<std::unique_ptr<IntersectPoint>> generate_intersects(
-    std::vector<std::unique_ptr<TransectLine>> &,
-    const std::vector<std::unique_ptr<Shoreline>> &);
+// The parallel passes below report their thread balance to the LoopBalance
+// they are given, if any.
 
-std::vector<std::unique_ptr<IntersectPoint>> generate_intersects(
-    std::vector<std::unique_ptr<TransectLine>> &, const Grids &);
+// Intersections of every transect with the shorelines, brute force or
+// through an index; each transect's intersects is set to its rows.
+IntersectTable generate_intersects(
+    TransectTable &, const std::vector<std::unique_ptr<Shoreline>> &,
+    LoopBalance *balance = nullptr);
 
+IntersectTable generate_intersects(TransectTable &, const Grids &,
+                                   LoopBalance *balance = nullptr);
+
+IntersectTable generate_intersects(TransectTable &, const RTree &,
+                                   LoopBalance *balance = nullptr);
+
+// Change rates of every transect without keeping the intersections: each
+// transect's are found and regressed in one parallel pass, leaving its
+// intersects empty and its change_rate untouched if it has none.
+void generate_rates(TransectTable &,
+                    const std::vector<std::unique_ptr<Shoreline>> &,
+                    LoopBalance *balance = nullptr);
+
+void generate_rates(TransectTable &, const Grids &,
+                    LoopBalance *balance = nullptr);
+
+void generate_rates(TransectTable &, const RTree &,
+                    LoopBalance *balance = nullptr);
+
+// Sets the change rate of every transect with intersections from its rows
+// of the table, in parallel; the others keep theirs.
+void set_change_rates(TransectTable &, const IntersectTable &,
+                      LoopBalance *balance = nullptr);
+
+// balance is that of build_transect_index, run if store_transect_cells.
 Grids build_spatial_grids(const std::vector<std::unique_ptr<Shoreline>> &,
-                          std::vector<std::unique_ptr<TransectLine>> &);
+                          TransectTable &, bool store_transect_cells = false,
+                          LoopBalance *balance = nullptr);
+
+// Buffers linearRegressRate sorts and fits in; a rate pass keeps one per
+// thread so it allocates nothing once warmed up.
+struct RateScratch {
+  struct Row {
+    std::int32_t date;  // as parsed (packed)
+    std::int32_t day;   // day number, for the regression
+    double distance;
+  };
+  std::vector<Row> rows;
+  std::vector<std::int32_t> x;
+  std::vector<double> y;
+};
 
-double linearRegressRate(std::vector<IntersectPoint *> &intersections);
+// Change rate in distance units per year of the rows in range, e.g. a
+// transect's intersects.
+double linearRegressRate(const IntersectTable &intersects,
+                         IntersectRange range, RateScratch &scratch);
+inline double linearRegressRate(const IntersectTable &intersects,
+                                IntersectRange range) {
+  RateScratch scratch;
+  return linearRegressRate(intersects, range, scratch);
+}
 }  // namespace dsas
 
 #endif
\ No newline at end of file
@@ -0,0 +1,250 @@
+#include "geojson.hpp"
+
+#include <cstdint>
+#include <fstream>
+
+#include "exception.hpp"
+
+namespace dsas {
+
+const nlohmann::json *GeoJsonFeature::property(std::string_view name) const {
+  for (const auto &[key, value] : properties) {
+    if (key == name) return &value;
+  }
+  return nullptr;
+}
+
+void GeoJsonFeature::clear() {
+  geometry_type.clear();
+  properties.clear();
+  points.clear();
+  parts.clear();
+}
+
+std::string GeoJsonCrs::projection(const std::filesystem::path &path) const {
+  if (!present) return "EPSG:4326";  // RFC 7946 implicit WGS84
+  if (type != "name" || name.empty()) {
+    OPENDSAS_THROW("Unsupported GeoJSON CRS format (expected type=name): " +
+                   path.string());
+  }
+  return name;
+}
+
+namespace {
+// SAX handler following where the parser is in the FeatureCollection with a
+// stack of the open objects and arrays. Values are kept only inside a
+// feature's properties and geometry, and in the collection's crs;
+// everything else is skipped. Without on_feature, features are skipped too
+// and parsing stops once the crs has been read.
+class FeatureReader {
+ public:
+  using json = nlohmann::json;
+
+  explicit FeatureReader(
+      const std::function<void(const GeoJsonFeature &)> &on_feature,
+      GeoJsonCrs &crs)
+      : on_feature_(on_feature), crs_(crs) {}
+
+  bool null() { return scalar(nullptr); }
+  bool boolean(bool value) { return scalar(value); }
+  bool number_integer(json::number_integer_t value) { return number(value); }
+  bool number_unsigned(json::number_unsigned_t value) {
+    return number(value);
+  }
+  bool number_float(json::number_float_t value, const std::string &) {
+    return number(value);
+  }
+  bool string(json::string_t &value) {
+    if (in(Context::Geometry) && frames_.back().key == "type") {
+      feature_.geometry_type = value;
+      return true;
+    }
+    if (in(Context::Crs) && frames_.back().key == "type") {
+      crs_.type = value;
+      return true;
+    }
+    if (in(Context::CrsProperties) && frames_.back().key == "name") {
+      crs_.name = value;
+      return true;
+    }
+    return scalar(std::move(value));
+  }
+  bool binary(json::binary_t &) { return true; }
+
+  bool key(json::string_t &key) {
+    frames_.back().key = key;
+    return true;
+  }
+
+  bool start_object(std::size_t) {
+    open(/*is_array=*/false);
+    return true;
+  }
+  bool end_object() {
+    if (in(Context::Feature)) {
+      on_feature_(feature_);
+      feature_.clear();
+    }
+    const bool crs_read = in(Context::Crs);
+    frames_.pop_back();
+    return !(crs_read && !on_feature_);
+  }
+
+  bool start_array(std::size_t) {
+    open(/*is_array=*/true);
+    return true;
+  }
+  bool end_array() {
+    if (in(Context::Coordinates) && num_coordinates_ > 0) end_position();
+    frames_.pop_back();
+    return true;
+  }
+
+  template <typename Exception>
+  bool parse_error(std::size_t, const std::string &, const Exception &ex) {
+    throw ex;
+  }
+
+ private:
+  enum class Context {
+    Root,           // the FeatureCollection
+    Crs,            // its crs
+    CrsProperties,  // the crs's properties
+    Features,       // its features array
+    Feature,        // one of them
+    Properties,     // the feature's properties
+    Geometry,       // the feature's geometry
+    Coordinates,    // an array in the geometry's coordinates
+    Other           // anything else, skipped
+  };
+  struct Frame {
+    Context context;
+    std::string key;      // last key read, in an object
+    std::uint64_t array;  // serial number of a Coordinates array
+  };
+
+  [[nodiscard]] bool in(Context context) const {
+    return !frames_.empty() && frames_.back().context == context;
+  }
+
+  // context of a new object or array, from the one it is opened in
+  void open(bool is_array) {
+    Context context = Context::Other;
+    if (frames_.empty()) {
+      if (!is_array) context = Context::Root;
+    } else {
+      const auto &parent = frames_.back();
+      switch (parent.context) {
+        case Context::Root:
+          if (is_array && parent.key == "features" && on_feature_) {
+            context = Context::Features;
+          } else if (!is_array && parent.key == "crs") {
+            context = Context::Crs;
+            crs_.present = true;
+          }
+          break;
+        case Context::Crs:
+          if (!is_array && parent.key == "properties") {
+            context = Context::CrsProperties;
+          }
+          break;
+        case Context::Features:
+          if (!is_array) context = Context::Feature;
+          break;
+        case Context::Feature:
+          if (!is_array && parent.key == "properties") {
+            context = Context::Properties;
+          } else if (!is_array && parent.key == "geometry") {
+            context = Context::Geometry;
+          }
+          break;
+        case Context::Properties:
+          feature_.properties.emplace_back(parent.key, nullptr);
+          break;
+        case Context::Geometry:
+          if (is_array && parent.key == "coordinates") {
+            context = Context::Coordinates;
+          }
+          break;
+        case Context::Coordinates:
+          if (is_array) context = Context::Coordinates;
+          break;
+        case Context::CrsProperties:
+        case Context::Other:
+          break;
+      }
+    }
+    if (context == Context::Coordinates) {
+      num_coordinates_ = 0;
+      ++arrays_;
+    }
+    frames_.push_back(Frame{context, {}, arrays_});
+  }
+
+  bool scalar(json value) {
+    // a crs that is not an object is still a crs, just not a supported one
+    if (in(Context::Root) && frames_.back().key == "crs") crs_.present = true;
+    if (in(Context::Properties)) {
+      feature_.properties.emplace_back(frames_.back().key, std::move(value));
+    }
+    return true;
+  }
+
+  template <typename Number>
+  bool number(Number value) {
+    if (!in(Context::Coordinates)) return scalar(value);
+    if (num_coordinates_ < 2) {
+      coordinates_[num_coordinates_] = static_cast<double>(value);
+    }
+    ++num_coordinates_;
+    return true;
+  }
+
+  // a position ends: its point starts a new line if the array holding it
+  // is not the one of the previous point
+  void end_position() {
+    if (num_coordinates_ < 2) {
+      OPENDSAS_THROW("GeoJSON position with fewer than two coordinates");
+    }
+    num_coordinates_ = 0;
+    const auto line = frames_[frames_.size() - 2].array;
+    if (feature_.points.empty() || line != line_) {
+      feature_.parts.push_back(feature_.points.size());
+      line_ = line;
+    }
+    feature_.points.emplace_back(coordinates_[0], coordinates_[1]);
+  }
+
+  const std::function<void(const GeoJsonFeature &)> &on_feature_;
+  GeoJsonCrs &crs_;
+  std::vector<Frame> frames_;
+  GeoJsonFeature feature_;
+  double coordinates_[2]{};
+  size_t num_coordinates_{0};
+  std::uint64_t arrays_{0};  // Coordinates arrays opened so far
+  std::uint64_t line_{0};    // array holding the last point
+};
+}  // namespace
+
+void read_geojson_features(
+    const std::filesystem::path &path,
+    const std::function<void(const GeoJsonFeature &)> &on_feature,
+    GeoJsonCrs *crs) {
+  std::ifstream f(path, std::ios::binary);
+  if (!f) OPENDSAS_THROW("Cannot open: " + path.string());
+  GeoJsonCrs unused;
+  FeatureReader reader(on_feature, crs ? *crs : unused);
+  nlohmann::json::sax_parse(f, &reader);
+}
+
+GeoJsonCrs read_geojson_crs(const std::filesystem::path &path) {
+  std::ifstream f(path, std::ios::binary);
+  if (!f) OPENDSAS_THROW("Cannot open file: " + path.string());
+  GeoJsonCrs crs;
+  const std::function<void(const GeoJsonFeature &)> no_features;
+  FeatureReader reader(no_features, crs);
+  nlohmann::json::sax_parse(f, &reader);
+  return crs;
+}
+
+}  // namespace dsas
@@ -0,0 +1,70 @@
+#ifndef SRC_GEOJSON_HPP_
+#define SRC_GEOJSON_HPP_
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <nlohmann/json.hpp>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "geometry.hpp"
+
+namespace dsas {
+
+// One feature of a GeoJSON FeatureCollection, as read by
+// read_geojson_features: its properties, geometry type and vertices.
+struct GeoJsonFeature {
+  std::string geometry_type;
+  // properties in file order; objects and arrays among them read as null
+  std::vector<std::pair<std::string, nlohmann::json>> properties;
+  std::vector<Point> points;  // vertices of every line, one after another
+  std::vector<size_t> parts;  // first point of each line
+
+  // the property with this name, or nullptr
+  [[nodiscard]] const nlohmann::json *property(std::string_view name) const;
+
+  [[nodiscard]] size_t num_parts() const { return parts.size(); }
+  [[nodiscard]] std::span<const Point> part(size_t k) const {
+    const size_t last = k + 1 < parts.size() ? parts[k + 1] : points.size();
+    return {points.data() + parts[k], last - parts[k]};
+  }
+
+  void clear();
+};
+
+// The "crs" member of a FeatureCollection, in the pre-RFC 7946 (2008) form
+// {"type":"name","properties":{"name":"EPSG:…"}}.
+struct GeoJsonCrs {
+  bool present = false;
+  std::string type;
+  std::string name;  // properties.name, empty if missing
+
+  // the projection string: name, or "EPSG:4326" (RFC 7946 implicit WGS84)
+  // if the file has no crs. Throws DSASError for any other crs form.
+  [[nodiscard]] std::string projection(
+      const std::filesystem::path &path) const;
+};
+
+// Streams the features of the GeoJSON FeatureCollection at path through an
+// event (SAX) parser, passing each one to on_feature as soon as it is read.
+// Only one feature is held at a time, however large the file; the feature
+// is reused, so on_feature must copy what it keeps. Positions keep their
+// first two coordinates. The collection's crs goes to crs if given. Throws
+// DSASError if the file cannot be opened or a position has fewer than two
+// numbers, and nlohmann::json::parse_error on malformed JSON.
+void read_geojson_features(
+    const std::filesystem::path &path,
+    const std::function<void(const GeoJsonFeature &)> &on_feature,
+    GeoJsonCrs *crs = nullptr);
+
+// Reads only the crs of the GeoJSON FeatureCollection at path, stopping as
+// soon as it has been read; features are skipped without being built.
+GeoJsonCrs read_geojson_crs(const std::filesystem::path &path);
+
+}  // namespace dsas
+
+#endif
@@ -8,16 +8,23 @@
 #define EPS_OFFSET 1e-6
 #define PI 3.1415926
 
+#include <algorithm>
+#include <charconv>
 #include <cmath>
 #include <compare>
+#include <cstdint>
 #include <filesystem>
+#include <limits>
 #include <memory>
 #include <optional>
+#include <string>
+#include <system_error>
 #include <tuple>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "exception.hpp"
 #include "options.hpp"
 
 // classes
@@ -42,6 +49,30 @@ struct Date {
            32045;
   }
 
+  // Inverse of julian_day().
+  static Date from_julian_day(long long jdn) {
+    const long long a = jdn + 32044;
+    const long long b = (4 * a + 3) / 146097;
+    const long long c = a - 146097 * b / 4;
+    const long long d = (4 * c + 3) / 1461;
+    const long long e = c - 1461 * d / 4;
+    const long long m = (5 * e + 2) / 153;
+    return Date{static_cast<int>(100 * b + d - 4800 + m / 10),
+                static_cast<int>(m + 3 - 12 * (m / 10)),
+                static_cast<int>(e - (153 * m + 2) / 5 + 1)};
+  }
+
+  // The date as the number YYYYMMDD, for years 0-214747. Unlike
+  // julian_day() it keeps day 0, which strptime leaves in formats without
+  // %d, and days past the end of the month apart.
+  [[nodiscard]] std::int32_t packed() const {
+    return year_ * 10000 + month_ * 100 + day_;
+  }
+  // Inverse of packed().
+  static Date from_packed(std::int32_t ymd) {
+    return Date{ymd / 10000, ymd / 100 % 100, ymd % 100};
+  }
+
   auto operator<=>(const Date &) const = default;
 };
 
@@ -49,6 +80,30 @@ inline long long days_between(const Date &a, const Date &b) {
   return a.julian_day() - b.julian_day();
 }
 
+// Longest output of format_date: a year of up to seven characters, /MM/DD.
+inline constexpr size_t max_date_chars = 13;
+
+// Writes the date as YYYY/MM/DD, the format of the intersection files, to
+// out (at least max_date_chars long, not terminated) and returns the end of
+// what was written. No locale, stream or allocation involved. Throws
+// DSASError if the year takes more than seven characters.
+inline char *format_date(const Date &date, char *out) {
+  auto two_digits = [](int value, char *at) {
+    at[0] = static_cast<char>('0' + value / 10 % 10);
+    at[1] = static_cast<char>('0' + value % 10);
+  };
+  const auto [year_end, ec] = std::to_chars(out, out + 7, date.year());
+  if (ec != std::errc()) {
+    OPENDSAS_THROW("Year out of range: " + std::to_string(date.year()));
+  }
+  out = year_end;
+  *out++ = '/';
+  two_digits(date.month(), out);
+  out[2] = '/';
+  two_digits(date.day(), out + 3);
+  return out + 5;
+}
+
 template <typename T>
 struct MultiLine {
   using value_type = T;
@@ -149,6 +204,27 @@ struct Point : public PointAttribute<double> {
   [[nodiscard]] double get_y() const override { return y; }
 };
 
+// Axis-aligned bounding box; empty (and intersecting nothing) until a point
+// is added.
+struct Envelope {
+  double min_x{std::numeric_limits<double>::max()};
+  double min_y{std::numeric_limits<double>::max()};
+  double max_x{std::numeric_limits<double>::lowest()};
+  double max_y{std::numeric_limits<double>::lowest()};
+
+  void expand(const Point &point) {
+    min_x = std::min(min_x, point.x);
+    min_y = std::min(min_y, point.y);
+    max_x = std::max(max_x, point.x);
+    max_y = std::max(max_y, point.y);
+  }
+  // boxes that only touch intersect
+  [[nodiscard]] bool intersects(const Envelope &other) const {
+    return min_x <= other.max_x && other.min_x <= max_x &&
+           min_y <= other.max_y && other.min_y <= max_y;
+  }
+};
+
 struct LineSegment {
   Point leftEdge_, rightEdge_;
   double slope_, orient_;
@@ -1,238 +1,316 @@
 #include "grid.hpp"
 
-#include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <memory>
-#include <queue>
+#include <numbers>
+
+#include "exception.hpp"
+#include "schedule.hpp"
+#include "transect.hpp"
 
 namespace dsas {
 
-double Grid::grids_bound_left_bottom_x = 0.0;
-double Grid::grids_bound_left_bottom_y = 0.0;
-double Grid::grids_bound_right_top_x = 0;
-double Grid::grids_bound_right_top_y = 0;
-double Grid::grid_size = 0.0;
-size_t Grid::grid_nx = 0;
-size_t Grid::grid_ny = 0;
+GridBound make_grid_bound(double left_bottom_x, double left_bottom_y,
+                          double right_top_x, double right_top_y,
+                          double grid_size) {
+  GridBound bound{left_bottom_x, left_bottom_y, right_top_x, right_top_y,
+                  grid_size};
+  if (grid_size > 0) {
+    bound.nx = static_cast<size_t>((right_top_x - left_bottom_x) / grid_size);
+    bound.ny = static_cast<size_t>((right_top_y - left_bottom_y) / grid_size);
+  }
+  return bound;
+}
 
-void compute_grid_bound(
-    const std::vector<std::unique_ptr<Shoreline>> &shorelines, bool padding) {
-  // two pq to find the median length of shorelines
-  std::priority_queue<double> max_pq;
-  std::priority_queue<double, std::vector<double>, std::greater<double>> min_pq;
-  double min_x = std::numeric_limits<double>::max();
-  double min_y = std::numeric_limits<double>::max();
-  double max_x = std::numeric_limits<double>::lowest();
-  double max_y = std::numeric_limits<double>::lowest();
-
-  for (const auto &shoreline : shorelines) {
-    for (size_t i = 0; i < shoreline->size(); i++) {
-      min_x = std::min(min_x, (*shoreline)[i].x);
-      max_x = std::max(max_x, (*shoreline)[i].x);
-      min_y = std::min(min_y, (*shoreline)[i].y);
-      max_y = std::max(max_y, (*shoreline)[i].y);
-      if (i < shoreline->size() - 1) {
-        double seg_len = (*shoreline)[i].distance_to_point((*shoreline)[i + 1]);
-        max_pq.push(seg_len);
-        min_pq.push(max_pq.top());
-        max_pq.pop();
-
-        if (max_pq.size() < min_pq.size()) {
-          max_pq.push(min_pq.top());
-          min_pq.pop();
+namespace {
+// Extent and segment lengths of a shoreline set.
+struct ShorelineStats {
+  double min_x{std::numeric_limits<double>::max()};
+  double min_y{std::numeric_limits<double>::max()};
+  double max_x{std::numeric_limits<double>::lowest()};
+  double max_y{std::numeric_limits<double>::lowest()};
+  std::vector<double> lengths;  // one per segment
+  double total_length{0};
+};
+
+// One parallel pass: each thread reduces the bounds of its shorelines and
+// writes their segment lengths into a buffer sized up front.
+ShorelineStats compute_shoreline_stats(
+    const std::vector<std::unique_ptr<Shoreline>> &shorelines) {
+  std::vector<size_t> first_length(shorelines.size() + 1, 0);
+  for (size_t i = 0; i < shorelines.size(); i++) {
+    const size_t n = shorelines[i]->size();
+    first_length[i + 1] = first_length[i] + (n > 0 ? n - 1 : 0);
+  }
+
+  ShorelineStats stats;
+  stats.lengths.resize(first_length.back());
+  const auto total = static_cast<std::int64_t>(shorelines.size());
+#pragma omp parallel
+  {
+    ShorelineStats local;
+#pragma omp for schedule(static)
+    for (std::int64_t i = 0; i < total; i++) {
+      const auto &pts = shorelines[i]->shoreline_vertices_;
+      double *lengths = stats.lengths.data() + first_length[i];
+      for (size_t j = 0; j < pts.size(); j++) {
+        local.min_x = std::min(local.min_x, pts[j].x);
+        local.max_x = std::max(local.max_x, pts[j].x);
+        local.min_y = std::min(local.min_y, pts[j].y);
+        local.max_y = std::max(local.max_y, pts[j].y);
+        if (j + 1 < pts.size()) {
+          lengths[j] = pts[j].distance_to_point(pts[j + 1]);
+          local.total_length += lengths[j];
         }
       }
     }
+#pragma omp critical
+    {
+      stats.min_x = std::min(stats.min_x, local.min_x);
+      stats.max_x = std::max(stats.max_x, local.max_x);
+      stats.min_y = std::min(stats.min_y, local.min_y);
+      stats.max_y = std::max(stats.max_y, local.max_y);
+      stats.total_length += local.total_length;
+    }
   }
-  double median_seg_len = max_pq.size() > min_pq.size()
-                              ? max_pq.top()
-                              : (min_pq.top() + max_pq.top()) / 2;
+  return stats;
+}
 
-  Grid::grid_size = median_seg_len;
+// Median in linear time; reorders lengths. Even counts average the two
+// middle values.
+double median_length(std::vector<double> &lengths) {
+  if (lengths.empty()) return 0;
+  const auto mid = lengths.begin() + lengths.size() / 2;
+  std::nth_element(lengths.begin(), mid, lengths.end());
+  if (lengths.size() % 2 == 1) return *mid;
+  return (*std::max_element(lengths.begin(), mid) + *mid) / 2;
+}
 
+GridBound pad_grid_bound(const ShorelineStats &stats, double grid_size,
+                         bool padding) {
   double padding_space{0};
   if (padding) {
-    padding_space = Grid::grid_size / 2;
+    padding_space = grid_size / 2;
+  }
+  return make_grid_bound(stats.min_x - padding_space,
+                         stats.min_y - padding_space,
+                         stats.max_x + padding_space,
+                         stats.max_y + padding_space, grid_size);
+}
+}  // namespace
+
+GridBound compute_grid_bound(
+    const std::vector<std::unique_ptr<Shoreline>> &shorelines, bool padding) {
+  auto stats = compute_shoreline_stats(shorelines);
+  return pad_grid_bound(stats, median_length(stats.lengths), padding);
+}
+
+GridBound compute_grid_bound_for_transects(
+    const std::vector<std::unique_ptr<Shoreline>> &shorelines,
+    double transect_length, bool padding) {
+  auto stats = compute_shoreline_stats(shorelines);
+  const double median = median_length(stats.lengths);
+  const auto num_segments = static_cast<double>(stats.lengths.size());
+  const double width = stats.max_x - stats.min_x;
+  const double height = stats.max_y - stats.min_y;
+  const double area = width * height;
+  if (num_segments == 0 || transect_length <= 0 || area <= 0) {
+    return pad_grid_bound(stats, median, padding);
   }
-  Grid::grids_bound_left_bottom_x = min_x - padding_space;
-  Grid::grids_bound_left_bottom_y = min_y - padding_space;
-  Grid::grids_bound_right_top_x = max_x + padding_space;
-  Grid::grids_bound_right_top_y = max_y + padding_space;
-  Grid::grid_nx = static_cast<size_t>(
-      (Grid::grids_bound_right_top_x - Grid::grids_bound_left_bottom_x) /
-      Grid::grid_size);
-  Grid::grid_ny = static_cast<size_t>(
-      (Grid::grids_bound_right_top_y - Grid::grids_bound_left_bottom_y) /
-      Grid::grid_size);
+
+  // A transect of length L takes about L / s grid steps and, by Buffon,
+  // crosses K = 2 * total_length * L / (pi * area) shoreline pieces; around
+  // each crossing it tests about 1 + s / mean_length segments. Minimising
+  // c * L / s + K * s / mean_length gives s = sqrt(c * L * mean_length / K).
+  constexpr double cell_to_segment_cost = 0.5;  // one cell step vs one test
+  const double mean_length = stats.total_length / num_segments;
+  const double crossings =
+      2 * stats.total_length * transect_length / (std::numbers::pi * area);
+  double grid_size = std::sqrt(cell_to_segment_cost * transect_length *
+                               mean_length / crossings);
+  // no cell longer than a transect, and at most about four cells per segment
+  grid_size = std::min(grid_size, std::max(transect_length, median));
+  grid_size = std::max(grid_size, std::sqrt(area / (4 * num_segments)));
+  return pad_grid_bound(stats, grid_size, padding);
 }
 
 Grids build_shoreline_index(
-    const std::vector<std::unique_ptr<Shoreline>> &shorelines) {
-  // basic sanity
-  assert(Grid::grid_size > 0.0);
-  assert(Grid::grids_bound_right_top_x > Grid::grids_bound_left_bottom_x);
-  assert(Grid::grids_bound_right_top_y > Grid::grids_bound_left_bottom_y);
-
-  const double left_bottom_x = Grid::grids_bound_left_bottom_x;
-  const double left_bottom_y = Grid::grids_bound_left_bottom_y;
-  const double right_top_x = Grid::grids_bound_right_top_x;
-  const double right_top_y = Grid::grids_bound_right_top_y;
-  const double grid_size = Grid::grid_size;
-
-  // derive nx, ny from grids or bounds
-  int nx = static_cast<int>((right_top_x - left_bottom_x) / grid_size);
-  int ny = static_cast<int>((right_top_y - left_bottom_y) / grid_size);
-  assert(nx > 0 && ny > 0);
+    const std::vector<std::unique_ptr<Shoreline>> &shorelines,
+    const GridBound &bound) {
+  // compute_grid_bound of shorelines without a segment has no cells
+  if (!(bound.grid_size > 0) || bound.nx == 0 || bound.ny == 0) {
+    OPENDSAS_THROW(
+        "Cannot build the grid index: the grid bound has no cells (no "
+        "shoreline segments?)");
+  }
+
+  const double left_bottom_x = bound.left_bottom_x;
+  const double left_bottom_y = bound.left_bottom_y;
+  const double grid_size = bound.grid_size;
+  const int nx = static_cast<int>(bound.nx);
+  const int ny = static_cast<int>(bound.ny);
 
   auto compute_index_x = [&](const double x) {
-    int x_index =
-        static_cast<int>(std::ceil(x - left_bottom_x) / grid_size) - 1;
-    if (x_index < 0) {
-      x_index = 0;
-    }
-    if (x_index >= nx) {
-      x_index = nx - 1;
-    }
-    return x_index;
+    return clamp_cell_index(cell_index(x, left_bottom_x, grid_size), nx);
   };
-
   auto compute_index_y = [&](const double y) {
-    int y_index =
-        static_cast<int>(std::ceil(y - left_bottom_y) / grid_size) - 1;
-    if (y_index < 0) {
-      y_index = 0;
-    }
-    if (y_index >= ny) {
-      y_index = ny - 1;
-    }
-    return y_index;
+    return clamp_cell_index(cell_index(y, left_bottom_y, grid_size), ny);
   };
 
   Grids grids;
-  for (const auto &shoreline : shorelines) {
-    const auto &pts = shoreline->shoreline_vertices_;
-    if (pts.size() < 2) continue;
-
-    for (size_t j = 0; j + 1 < pts.size(); ++j) {
-      const auto &a = pts[j];
-      const auto &b = pts[j + 1];
-
-      // segment bbox
-      const double xmin = std::min(a.x, b.x);
-      const double xmax = std::max(a.x, b.x);
-      const double ymin = std::min(a.y, b.y);
-      const double ymax = std::max(a.y, b.y);
-
-      // map to inclusive cell range (half-open convention)
-      int ix0 = compute_index_x(xmin);
-      int ix1 = compute_index_x(xmax);
-      int iy0 = compute_index_y(ymin);
-      int iy1 = compute_index_y(ymax);
+  grids.bound = bound;
+  grids.assign(shorelines);
+
+  // Visit every (cell, segment) pair in parallel; a segment is put into all
+  // the cells overlapped by its bbox. The loop runs over the dense segment
+  // ids so long shorelines are split across threads too.
+  const auto num_ids = static_cast<std::int64_t>(grids.num_segment_ids());
+  auto for_each_cell_seg = [&](auto &&visit) {
+#pragma omp parallel for schedule(static)
+    for (std::int64_t id = 0; id < num_ids; id++) {
+      const auto shoreline = static_cast<std::uint32_t>(
+          std::upper_bound(grids.first_segment_id.begin(),
+                           grids.first_segment_id.end(),
+                           static_cast<std::uint32_t>(id)) -
+          grids.first_segment_id.begin() - 1);
+      const SegRef seg{shoreline, static_cast<std::uint32_t>(
+                                      id - grids.first_segment_id[shoreline])};
+      // the last vertex of a shoreline starts no segment
+      if (seg.vertex + 1 >= grids.shorelines[shoreline]->size()) continue;
+      const auto &a = grids.start(seg);
+      const auto &b = grids.end(seg);
+
+      // map segment bbox to inclusive cell range (half-open convention)
+      int ix0 = compute_index_x(std::min(a.x, b.x));
+      int ix1 = compute_index_x(std::max(a.x, b.x));
+      int iy0 = compute_index_y(std::min(a.y, b.y));
+      int iy1 = compute_index_y(std::max(a.y, b.y));
 
       // if clamped min > max, the bbox doesn't overlap the grid
       if (ix0 > ix1 || iy0 > iy1) continue;
 
-      // insert this segment ID (shoreline si, local segment j) into all
-      // overlapped cells
       for (int ix = ix0; ix <= ix1; ++ix) {
         for (int iy = iy0; iy <= iy1; ++iy) {
-          size_t grids_id = ix * ny + iy;
-          if (grids.find(grids_id) == grids.end()) {
-            grids[grids_id] =
-                std::make_unique<Grid>(left_bottom_x + ix * grid_size,
-                                       left_bottom_y + iy * grid_size, ix, iy);
-          }
-          grids[grids_id]->shoreline_segs.emplace_back(a, b, shoreline.get());
+          visit(static_cast<size_t>(ix) * ny + iy, seg);
         }
       }
     }
-  }
-  return grids;
-}
+  };
 
-void build_transect_index(
-    std::vector<std::unique_ptr<TransectLine>> &transects) {
-  // Basic sanity
-  assert(Grid::grid_size > 0.0);
-  assert(Grid::grids_bound_right_top_x > Grid::grids_bound_left_bottom_x);
-  assert(Grid::grids_bound_right_top_y > Grid::grids_bound_left_bottom_y);
+  // Pass 1: count the segments of each cell, then prefix sum into offsets.
+  // One shared array of atomic counters rather than one array per thread:
+  // fine grids have millions of cells, and copies per core would cost more
+  // memory than the index itself.
+  std::vector<std::uint32_t> counts(grids.num_cells(), 0);
+  for_each_cell_seg([&](size_t cell_id, SegRef) {
+    std::atomic_ref<std::uint32_t>(counts[cell_id])
+        .fetch_add(1, std::memory_order_relaxed);
+  });
 
-  const double left_bottom_x = Grid::grids_bound_left_bottom_x;
-  const double left_bottom_y = Grid::grids_bound_left_bottom_y;
-  const double right_top_x = Grid::grids_bound_right_top_x;
-  const double right_top_y = Grid::grids_bound_right_top_y;
-  const double grid_size = Grid::grid_size;
+  grids.cell_offsets.resize(grids.num_cells() + 1);
+  std::uint64_t total = 0;
+  for (size_t c = 0; c < counts.size(); ++c) {
+    grids.cell_offsets[c] = static_cast<std::uint32_t>(total);
+    total += counts[c];
+  }
+  if (total > std::numeric_limits<std::uint32_t>::max()) {
+    OPENDSAS_THROW("Too many shoreline segments for the spatial index");
+  }
+  grids.cell_offsets.back() = static_cast<std::uint32_t>(total);
 
-  // compute grid dims once (avoid recomputing in every loop)
-  int nx = static_cast<int>((right_top_x - left_bottom_x) / grid_size);
-  int ny = static_cast<int>((right_top_y - left_bottom_y) / grid_size);
-  assert(nx > 0 && ny > 0);
+  // pass 2: scatter the segments into their cells, reusing counts as cursors
+  grids.shoreline_segs.resize(total);
+  std::copy(grids.cell_offsets.begin(), grids.cell_offsets.end() - 1,
+            counts.begin());
+  for_each_cell_seg([&](size_t cell_id, SegRef seg) {
+    const auto slot = std::atomic_ref<std::uint32_t>(counts[cell_id])
+                          .fetch_add(1, std::memory_order_relaxed);
+    grids.shoreline_segs[slot] = seg;
+  });
 
-  auto compute_index_x = [&](const double x) {
-    int x_index =
-        static_cast<int>(std::ceil(x - left_bottom_x) / grid_size) - 1;
-    if (x_index < 0) {
-      x_index = 0;
-    }
-    if (x_index >= nx) {
-      x_index = nx - 1;
-    }
-    return x_index;
-  };
+  // threads fill a cell in any order; restore the serial (shoreline, vertex)
+  // order so the index and everything found through it is deterministic
+  const auto num_cells = static_cast<std::int64_t>(grids.num_cells());
+#pragma omp parallel for schedule(static)
+  for (std::int64_t c = 0; c < num_cells; c++) {
+    std::sort(grids.shoreline_segs.begin() + grids.cell_offsets[c],
+              grids.shoreline_segs.begin() + grids.cell_offsets[c + 1],
+              [](SegRef a, SegRef b) {
+                return a.shoreline != b.shoreline ? a.shoreline < b.shoreline
+                                                  : a.vertex < b.vertex;
+              });
+  }
+  return grids;
+}
 
-  auto compute_index_y = [&](const double y) {
-    int y_index =
-        static_cast<int>(std::ceil(y - left_bottom_y) / grid_size) - 1;
-    if (y_index < 0) {
-      y_index = 0;
-    }
-    if (y_index >= ny) {
-      y_index = ny - 1;
+bool clip_to_grid_bound(const GridBound &bound, Point &a, Point &b) {
+  const double dx = b.x - a.x;
+  const double dy = b.y - a.y;
+
+  // Liang-Barsky: shrink [t0, t1] by each of the four half planes p * t <= q
+  double t0 = 0.0, t1 = 1.0;
+  auto clip = [&](double p, double q) {
+    if (p == 0) return q >= 0;
+    const double r = q / p;
+    if (p < 0) {
+      if (r > t1) return false;
+      t0 = std::max(t0, r);
+    } else {
+      if (r < t0) return false;
+      t1 = std::min(t1, r);
     }
-    return y_index;
+    return true;
   };
-  const auto total = static_cast<std::int64_t>(transects.size());
-#pragma omp parallel for schedule(static)
-  for (std::int64_t i = 0; i < total; i++) {
-    auto &transect = transects[i];
-    const double min_x =
-        std::min(transect->leftEdge_.x, transect->rightEdge_.x);
-    const double max_x =
-        std::max(transect->leftEdge_.x, transect->rightEdge_.x);
-    const double min_y =
-        std::min(transect->leftEdge_.y, transect->rightEdge_.y);
-    const double max_y =
-        std::max(transect->leftEdge_.y, transect->rightEdge_.y);
-
-    // Early skip if bbox is entirely outside the grid bounds (cheap)
-    if (max_x < left_bottom_x || min_x > right_top_x || max_y < left_bottom_y ||
-        min_y > right_top_y) {
-      continue;
-    }
+  if (!clip(-dx, a.x - bound.left_bottom_x) ||
+      !clip(dx, bound.right_top_x - a.x) ||
+      !clip(-dy, a.y - bound.left_bottom_y) ||
+      !clip(dy, bound.right_top_y - a.y)) {
+    return false;
+  }
 
-    // Convert to cell indices (inclusive range)
-    int ix0 = compute_index_x(min_x);
-    int ix1 = compute_index_x(max_x);
-    int iy0 = compute_index_y(min_y);
-    int iy1 = compute_index_y(max_y);
+  const Point origin = a;
+  if (t1 < 1.0) b = Point(origin.x + t1 * dx, origin.y + t1 * dy);
+  if (t0 > 0.0) a = Point(origin.x + t0 * dx, origin.y + t0 * dy);
+  return true;
+}
 
-    // Handle possible inversion (segment entirely outside after clamping)
-    if (ix0 > ix1 || iy0 > iy1) {
-      continue;
-    }
+void build_transect_index(TransectTable &transects, const GridBound &bound,
+                          LoopBalance *balance) {
+  const size_t n = transects.size();
+  auto walk = [&](size_t i, auto &&visit) {
+    traverse_grid(bound, Point{transects.left_x[i], transects.left_y[i]},
+                  Point{transects.right_x[i], transects.right_y[i]}, visit);
+  };
+  // cost: about the number of cells the transect crosses
+  auto cost = [&](size_t i) {
+    return (std::abs(transects.right_x[i] - transects.left_x[i]) +
+            std::abs(transects.right_y[i] - transects.left_y[i])) /
+           bound.grid_size;
+  };
 
-    // Reserve to avoid repeated reallocs if you store many cells
-    const int cells_x = ix1 - ix0 + 1;
-    const int cells_y = iy1 - iy0 + 1;
-    transect->grid_index.reserve(transect->grid_index.size() +
-                                 cells_x * cells_y);
+  // one walk counts the cells of each transect, a second one stores them at
+  // their place in the table
+  auto &first = transects.cell_first;
+  first.assign(n + 1, 0);
+  for_each_balanced(
+      n, cost,
+      [&](size_t i, int) { walk(i, [&](int, int) { ++first[i + 1]; }); },
+      balance);
+  for (size_t i = 0; i < n; i++) first[i + 1] += first[i];
 
-    for (int ix = ix0; ix <= ix1; ++ix) {
-      for (int iy = iy0; iy <= iy1; ++iy) {
-        transect->grid_index.emplace_back(static_cast<size_t>(ix),
-                                          static_cast<size_t>(iy));
-      }
-    }
-  }
+  transects.cells.resize(first.back());
+  transects.cells_bound = bound;
+  for_each_balanced(
+      n, cost,
+      [&](size_t i, int) {
+        auto *cell = transects.cells.data() + first[i];
+        walk(i, [&](int ix, int iy) { *cell++ = {ix, iy}; });
+      },
+      balance);
 }
 }  // namespace dsas
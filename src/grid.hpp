@@ -1,42 +1,186 @@
 #ifndef SRC_GRID_HPP_
 #define SRC_GRID_HPP_
 
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
 #include <memory>
-#include <unordered_map>
+#include <span>
+#include <utility>
 #include <vector>
 
 #include "shoreline.hpp"
-#include "transect.hpp"
 
 namespace dsas {
-struct Grid {
-  static double grids_bound_left_bottom_x;  // left_bottom of all grids
-  static double grids_bound_left_bottom_y;
-  static double grids_bound_right_top_x;  // right_top of all grids
-  static double grids_bound_right_top_y;
-  static double grid_size;
-  static size_t grid_nx;
-  static size_t grid_ny;
-
-  double min_x, min_y;
-  size_t i, j;  // index in Grids
-  std::vector<ShoreSeg> shoreline_segs;
-  Grid(double min_x, double min_y, size_t i, size_t j)
-      : min_x{min_x}, min_y{min_y}, i{i}, j{j} {}
+struct TransectTable;  // forward declaration
+struct LoopBalance;    // forward declaration
+
+// Bounds of a uniform grid and its resolution. Cell (i, j) covers
+// (left_bottom + (i, j) * grid_size, left_bottom + (i + 1, j + 1) * grid_size];
+// the strip between the last grid line and right_top joins the border cells.
+struct GridBound {
+  double left_bottom_x{0}, left_bottom_y{0};
+  double right_top_x{0}, right_top_y{0};
+  double grid_size{0};
+  size_t nx{0}, ny{0};
+
+  bool operator==(const GridBound &) const = default;
 };
 
-void compute_grid_bound(
+// Bound over [left_bottom, right_top] with the cell counts filled in.
+GridBound make_grid_bound(double left_bottom_x, double left_bottom_y,
+                          double right_top_x, double right_top_y,
+                          double grid_size);
+
+// Cell index of coordinate v along one axis. Cell k covers the half-open
+// range (origin + k * grid_size, origin + (k + 1) * grid_size].
+inline int cell_index(double v, double origin, double grid_size) {
+  return static_cast<int>(std::ceil((v - origin) / grid_size)) - 1;
+}
+
+inline int clamp_cell_index(int index, int n) {
+  return std::clamp(index, 0, n - 1);
+}
+
+// Clips segment [a, b] to the grid bounds; false if it misses them entirely.
+bool clip_to_grid_bound(const GridBound &bound, Point &a, Point &b);
+
+// Visits the grid cells crossed by segment [a, b] in order from a to b,
+// walking from one grid line to the next (Amanatides-Woo) so the cost is
+// linear in the segment length. A segment passing through a cell corner also
+// visits the two cells beside that corner.
+template <typename Visit>
+void traverse_grid(const GridBound &bound, Point a, Point b, Visit &&visit) {
+  const double left_bottom_x = bound.left_bottom_x;
+  const double left_bottom_y = bound.left_bottom_y;
+  const double grid_size = bound.grid_size;
+  const int nx = static_cast<int>(bound.nx);
+  const int ny = static_cast<int>(bound.ny);
+  if (nx <= 0 || ny <= 0 || !clip_to_grid_bound(bound, a, b)) return;
+
+  // The walk runs on unclamped indices; the strip between the last grid line
+  // and the bound clamps back onto the border cells like the shoreline index.
+  int ix = cell_index(a.x, left_bottom_x, grid_size);
+  int iy = cell_index(a.y, left_bottom_y, grid_size);
+  const int ix_end = cell_index(b.x, left_bottom_x, grid_size);
+  const int iy_end = cell_index(b.y, left_bottom_y, grid_size);
+  const int step_x = ix_end >= ix ? 1 : -1;
+  const int step_y = iy_end >= iy ? 1 : -1;
+  int steps_x = std::abs(ix_end - ix);
+  int steps_y = std::abs(iy_end - iy);
+
+  // segment parameter at which the next vertical / horizontal line is crossed
+  const double dx = b.x - a.x, dy = b.y - a.y;
+  const double inf = std::numeric_limits<double>::infinity();
+  double t_max_x = inf, t_delta_x = inf, t_max_y = inf, t_delta_y = inf;
+  if (steps_x > 0) {
+    const int line = step_x > 0 ? ix + 1 : ix;
+    t_max_x = (left_bottom_x + line * grid_size - a.x) / dx;
+    t_delta_x = grid_size / std::abs(dx);
+  }
+  if (steps_y > 0) {
+    const int line = step_y > 0 ? iy + 1 : iy;
+    t_max_y = (left_bottom_y + line * grid_size - a.y) / dy;
+    t_delta_y = grid_size / std::abs(dy);
+  }
+
+  int last_x = -1, last_y = -1;
+  auto emit = [&](int i, int j) {
+    i = clamp_cell_index(i, nx);
+    j = clamp_cell_index(j, ny);
+    if (i == last_x && j == last_y) return;
+    last_x = i;
+    last_y = j;
+    visit(i, j);
+  };
+
+  constexpr double corner_tolerance = 1e-9;
+  emit(ix, iy);
+  while (steps_x > 0 || steps_y > 0) {
+    if (steps_x > 0 && steps_y > 0 &&
+        std::abs(t_max_x - t_max_y) <= corner_tolerance) {
+      // through a corner: take both neighbours, then the diagonal cell
+      emit(ix + step_x, iy);
+      emit(ix, iy + step_y);
+      ix += step_x;
+      iy += step_y;
+      --steps_x;
+      --steps_y;
+      t_max_x += t_delta_x;
+      t_max_y += t_delta_y;
+    } else if (steps_y == 0 || (steps_x > 0 && t_max_x < t_max_y)) {
+      ix += step_x;
+      --steps_x;
+      t_max_x += t_delta_x;
+    } else {
+      iy += step_y;
+      --steps_y;
+      t_max_y += t_delta_y;
+    }
+    emit(ix, iy);
+  }
+}
+
+// Uniform grid over the shoreline segments, stored in compressed sparse row
+// form: the segments of cell (i, j) are
+// shoreline_segs[cell_offsets[id] .. cell_offsets[id + 1]) with id = i*ny + j.
+// Each index carries its own bounds, so several can be built and queried
+// side by side.
+struct Grids : IndexedShorelines {
+  GridBound bound;
+  std::vector<std::uint32_t> cell_offsets;  // nx * ny + 1 entries
+  std::vector<SegRef> shoreline_segs;       // segments of every cell, packed
+
+  [[nodiscard]] size_t num_cells() const { return bound.nx * bound.ny; }
+  [[nodiscard]] bool empty() const { return shoreline_segs.empty(); }
+
+  [[nodiscard]] std::span<const SegRef> cell(size_t id) const {
+    if (id >= num_cells()) return {};
+    return {shoreline_segs.data() + cell_offsets[id],
+            shoreline_segs.data() + cell_offsets[id + 1]};
+  }
+  [[nodiscard]] std::span<const SegRef> cell(size_t i, size_t j) const {
+    if (i >= bound.nx || j >= bound.ny) return {};
+    return cell(i * bound.ny + j);
+  }
+
+  // world-space origin (left bottom corner) of cell (i, j)
+  [[nodiscard]] Point cell_origin(size_t i, size_t j) const {
+    return {bound.left_bottom_x + static_cast<double>(i) * bound.grid_size,
+            bound.left_bottom_y + static_cast<double>(j) * bound.grid_size};
+  }
+
+  // visits the cells crossed by segment [a, b], see traverse_grid
+  template <typename Visit>
+  void traverse(const Point &a, const Point &b, Visit &&visit) const {
+    traverse_grid(bound, a, b, std::forward<Visit>(visit));
+  }
+};
+
+// Bounds of the shorelines with the median segment length as cell size.
+GridBound compute_grid_bound(
     const std::vector<std::unique_ptr<Shoreline>> &shorelines,
     bool padding = true);
 
-using Grids = std::unordered_map<size_t, std::unique_ptr<Grid>>;
+// Bounds of the shorelines with the cell size that minimises the estimated
+// query cost of transects of the given length.
+GridBound compute_grid_bound_for_transects(
+    const std::vector<std::unique_ptr<Shoreline>> &shorelines,
+    double transect_length, bool padding = true);
 
+// Grid of the shoreline segments over bound. Throws DSASError if the bound
+// has no cells, as for shorelines without a segment.
 Grids build_shoreline_index(
-    const std::vector<std::unique_ptr<Shoreline>> &shorelines);
+    const std::vector<std::unique_ptr<Shoreline>> &shorelines,
+    const GridBound &bound);
 
-void build_transect_index(
-    std::vector<std::unique_ptr<TransectLine>> &transects);
+// Stores in the table the cells each transect crosses in a grid with this
+// bound. The thread balance of the pass goes to balance, if given.
+void build_transect_index(TransectTable &transects, const GridBound &bound,
+                          LoopBalance *balance = nullptr);
 
 }  // namespace dsas
-#endif
\ No newline at end of file
+#endif
@@ -1,19 +1,124 @@
 #include "intersect.hpp"
 
-#include <cassert>
+#include <shapefil.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <tuple>
+
+#include "exception.hpp"
+#include "options.hpp"
 #include "utility.hpp"
 
 namespace dsas {
 
-void save_intersects(
-    const std::vector<std::unique_ptr<IntersectPoint>> &intersects,
-    const std::string &prj) {
-  std::vector<IntersectPoint *> tmp_save;
-  tmp_save.reserve(intersects.size());
-  std::transform(intersects.begin(), intersects.end(),
-                 std::back_inserter(tmp_save),
-                 [](const auto &up) { return up.get(); });
-  save_points(tmp_save, prj, dsas::options.intersect_path);
+void IntersectTable::reserve(size_t n) {
+  x.reserve(n);
+  y.reserve(n);
+  transect_id.reserve(n);
+  shoreline_id.reserve(n);
+  baseline_id.reserve(n);
+  ymd.reserve(n);
+  day.reserve(n);
+  distance.reserve(n);
+}
+
+void IntersectTable::clear() {
+  x.clear();
+  y.clear();
+  transect_id.clear();
+  shoreline_id.clear();
+  baseline_id.clear();
+  ymd.clear();
+  day.clear();
+  distance.clear();
+}
+
+void IntersectTable::resize(size_t n) {
+  x.resize(n);
+  y.resize(n);
+  transect_id.resize(n);
+  shoreline_id.resize(n);
+  baseline_id.resize(n);
+  ymd.resize(n);
+  day.resize(n);
+  distance.resize(n);
+}
+
+void IntersectTable::copy_rows(size_t to, const IntersectTable &other,
+                               size_t from, size_t count) {
+  auto copy = [&](const auto &src, auto &dst) {
+    std::copy_n(src.begin() + from, count, dst.begin() + to);
+  };
+  copy(other.x, x);
+  copy(other.y, y);
+  copy(other.transect_id, transect_id);
+  copy(other.shoreline_id, shoreline_id);
+  copy(other.baseline_id, baseline_id);
+  copy(other.ymd, ymd);
+  copy(other.day, day);
+  copy(other.distance, distance);
+}
+
+void save_intersects(const IntersectTable &intersects,
+                     const std::string &prj) {
+  if (intersects.empty()) {
+    OPENDSAS_THROW("No point to save!");
+  }
+  if (!looks_like_proj(prj)) {
+    OPENDSAS_THROW("Projection setting failed");
+  }
+
+  // GCOVR_EXCL_START
+  const std::filesystem::path output_path = options.intersect_path;
+  auto base = output_path;
+  base.replace_extension("");
+  const std::string base_str = base.string();
+
+  SHPHandle hSHP = SHPCreate(base_str.c_str(), SHPT_POINT);
+  if (!hSHP) {
+    OPENDSAS_THROW("Failed to create shapefile: " + output_path.string());
+  }
+  DBFHandle hDBF = DBFCreate(base_str.c_str());
+  if (!hDBF) {
+    SHPClose(hSHP);
+    OPENDSAS_THROW("Failed to create DBF: " + output_path.string());
+  }
+
+  dbf_add_field(hDBF, "BaselineId", FieldType::Integer);
+  dbf_add_field(hDBF, "TransectId", FieldType::Integer);
+  dbf_add_field(hDBF, "ShoreID", FieldType::Integer);
+  dbf_add_field(hDBF, "Date", FieldType::String);
+  dbf_add_field(hDBF, "ref_dist", FieldType::Real);
+  dbf_add_field(hDBF, "X", FieldType::Real);
+  dbf_add_field(hDBF, "Y", FieldType::Real);
+
+  // rows of one shoreline share a date: format it only when it changes
+  char date[max_date_chars + 1];
+  std::int32_t last_date = 0;
+  for (size_t i = 0; i < intersects.size(); ++i) {
+    double x = intersects.x[i], y = intersects.y[i];
+    SHPObject *obj = SHPCreateSimpleObject(SHPT_POINT, 1, &x, &y, nullptr);
+    SHPWriteObject(hSHP, -1, obj);
+    SHPDestroyObject(obj);
+
+    if (i == 0 || intersects.ymd[i] != last_date) {
+      last_date = intersects.ymd[i];
+      *format_date(intersects.date(i), date) = '\0';
+    }
+    const auto rec = static_cast<int>(i);
+    write_dbf_record(hDBF, rec,
+                     std::tuple{intersects.baseline_id[i],
+                                intersects.transect_id[i],
+                                intersects.shoreline_id[i],
+                                static_cast<const char *>(date),
+                                intersects.distance[i], x, y});
+  }
+
+  SHPClose(hSHP);
+  DBFClose(hDBF);
+  write_prj(output_path, prj);
+  // GCOVR_EXCL_STOP
 }
-}  // namespace dsas
\ No newline at end of file
+}  // namespace dsas
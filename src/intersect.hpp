@@ -1,60 +1,80 @@
 #ifndef SRC_INTERSECT_HPP_
 #define SRC_INTERSECT_HPP_
 
-#include <iomanip>
-#include <sstream>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 #include "geometry.hpp"
 
 namespace dsas {
-using IntersectField =
-    std::tuple<int, int, int, const char *, double, double, double>;
-struct IntersectPoint : public Point, ShpSavable<IntersectField> {
-  int transect_id_;
-  int shoreline_id_;
-  int baseline_id_;
-  Date date_;
-  std::string date_string_;
-  double distance_to_ref_{-1};
-  IntersectPoint(Point point, int transect_id, int shoreline_id,
-                 int baseline_id, Date date, double distance_to_ref)
-      : Point(point),
-        transect_id_(transect_id),
-        shoreline_id_(shoreline_id),
-        baseline_id_(baseline_id),
-        date_(date),
-        distance_to_ref_(distance_to_ref) {
-    std::ostringstream oss;
-    oss << date_.year() << "/" << std::setw(2) << std::setfill('0')
-        << date_.month() << "/" << std::setw(2) << std::setfill('0')
-        << date_.day();
-    date_string_ = oss.str();
-  }
 
-  [[nodiscard]] std::vector<std::string> get_names() const override {
-    return {"BaselineId", "TransectId", "ShoreID", "Date",
-            "ref_dist",   "X",          "Y"};
-  }
+// One intersection of a transect with a shoreline.
+struct IntersectRow {
+  double x, y;
+  int transect_id;
+  int shoreline_id;
+  int baseline_id;
+  std::int32_t ymd;  // Date::packed() of the shoreline, as parsed
+  std::int32_t day;  // its Date::julian_day(), the regression's x axis
+  double distance;   // to the transect's reference point
+};
+
+// Rows [first, first + count) of an IntersectTable, e.g. the intersections
+// of one transect.
+struct IntersectRange {
+  size_t first{0};
+  size_t count{0};
+
+  [[nodiscard]] bool empty() const { return count == 0; }
+  [[nodiscard]] size_t size() const { return count; }
+};
+
+// Intersections in columnar form, one array per field, so a run holds about
+// 44 bytes per intersection and the rate and save passes only touch the
+// columns they read. Rows of the same transect are contiguous.
+struct IntersectTable {
+  std::vector<double> x, y;
+  std::vector<int> transect_id;
+  std::vector<int> shoreline_id;
+  std::vector<int> baseline_id;
+  std::vector<std::int32_t> ymd;
+  std::vector<std::int32_t> day;
+  std::vector<double> distance;
+
+  [[nodiscard]] size_t size() const { return x.size(); }
+  [[nodiscard]] bool empty() const { return x.empty(); }
 
-  [[nodiscard]] std::vector<FieldType> get_types() const override {
-    return {FieldType::Integer, FieldType::Integer, FieldType::Integer,
-            FieldType::String,  FieldType::Real,    FieldType::Real,
-            FieldType::Real};
+  void push_back(const IntersectRow &row) {
+    x.push_back(row.x);
+    y.push_back(row.y);
+    transect_id.push_back(row.transect_id);
+    shoreline_id.push_back(row.shoreline_id);
+    baseline_id.push_back(row.baseline_id);
+    ymd.push_back(row.ymd);
+    day.push_back(row.day);
+    distance.push_back(row.distance);
   }
 
-  [[nodiscard]] value_tuple get_values() const override {
-    return {baseline_id_,
-            transect_id_,
-            shoreline_id_,
-            date_string_.c_str(),
-            distance_to_ref_,
-            x,
-            y};
+  [[nodiscard]] IntersectRow operator[](size_t i) const {
+    return {x[i],           y[i],   transect_id[i], shoreline_id[i],
+            baseline_id[i], ymd[i], day[i],         distance[i]};
   }
+
+  [[nodiscard]] Date date(size_t i) const { return Date::from_packed(ymd[i]); }
+
+  void reserve(size_t n);
+  void resize(size_t n);
+  void clear();
+  // overwrites rows [to, to + count) with rows [from, from + count) of other
+  void copy_rows(size_t to, const IntersectTable &other, size_t from,
+                 size_t count);
 };
 
-void save_intersects(const std::vector<std::unique_ptr<IntersectPoint>> &,
-                     const std::string &);
+// Writes the table as a point shapefile with the fields BaselineId,
+// TransectId, ShoreID, Date, ref_dist, X and Y.
+void save_intersects(const IntersectTable &, const std::string &);
 }  // namespace dsas
 
 #endif
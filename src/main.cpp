@@ -3,25 +3,64 @@
 #include <filesystem>
 #include <iostream>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "baseline.hpp"
 #include "cli.hpp"
+#include "diagnostics.hpp"
 #include "dsas.hpp"
 #include "intersect.hpp"
 #include "options.hpp"
+#include "schedule.hpp"
 #include "shoreline.hpp"
 #include "transect.hpp"
 #include "utility.hpp"
 
 // --------------------------- runners ----------------------------------
 namespace {
-void cal_erosion_rate(std::vector<dsas::TransectLine>& transects) {
-  for (auto& transect : transects) {
-    auto intersects = transect.intersects;
-    auto reg_rate = dsas::linearRegressRate(intersects);
-    transect.change_rate = reg_rate;
+// Calls generate(transects, source) with the shoreline source the options
+// select: the shorelines themselves or an index built over them.
+template <typename Generate>
+auto with_shoreline_source(
+    dsas::TransectTable& transects,
+    const std::vector<std::unique_ptr<dsas::Shoreline>>& shorelines,
+    dsas::ThreadStats& stats, Generate&& generate) {
+  if (!dsas::options.build_index) {
+    return generate(transects, shorelines);
   }
+  if (dsas::options.spatial_index == dsas::Options::SpatialIndex::RTree) {
+    auto rtree = dsas::build_shoreline_rtree(shorelines);
+    return generate(transects, rtree);
+  }
+  auto grids = dsas::build_spatial_grids(shorelines, transects, false,
+                                         &stats.transect_index);
+  return generate(transects, grids);
+}
+
+// Sets the change rate of every transect and saves the transects, with the
+// intersections unless --no-intersects, in which case they are never kept.
+// The thread balance of the passes goes to stats.
+void calculate_and_save(
+    dsas::TransectTable& transects,
+    const std::vector<std::unique_ptr<dsas::Shoreline>>& shorelines,
+    const std::string& prj, dsas::ThreadStats& stats) {
+  if (!dsas::options.write_intersects) {
+    with_shoreline_source(transects, shorelines, stats,
+                          [&](auto& lines, const auto& source) {
+                            dsas::generate_rates(lines, source, &stats.rates);
+                          });
+    dsas::save_transect(transects, prj);
+    return;
+  }
+
+  auto intersects = with_shoreline_source(
+      transects, shorelines, stats, [&](auto& lines, const auto& source) {
+        return dsas::generate_intersects(lines, source, &stats.intersects);
+      });
+  dsas::set_change_rates(transects, intersects, &stats.rates);
+  dsas::save_transect(transects, prj);
+  dsas::save_intersects(intersects, prj);
 }
 
 void print_messages() {
@@ -29,90 +68,70 @@ void print_messages() {
   std::cout << "Your shoreline path: "
             << std::filesystem::absolute(dsas::options.shoreline_path) << "\n"
             << "Your baseline path: "
-            << std::filesystem::absolute(dsas::options.baseline_path) << "\n"
-            << "Output intersects path: "
-            << std::filesystem::absolute(dsas::options.intersect_path) << "\n"
-            << "Output transects path (with erosion rate): "
+            << std::filesystem::absolute(dsas::options.baseline_path) << "\n";
+  if (dsas::options.write_intersects) {
+    std::cout << "Output intersects path: "
+              << std::filesystem::absolute(dsas::options.intersect_path)
+              << "\n";
+  }
+  std::cout << "Output transects path (with erosion rate): "
             << std::filesystem::absolute(dsas::options.transect_path) << "\n";
   std::cout << "Start to run\n";
 }
 
-void run_root() {
+void run_root(dsas::ThreadStats& stats) {
   print_messages();
 
   auto baselines = dsas::load_baselines_shp(dsas::options.baseline_path,
                                             dsas::options.baseline_id_field);
-  auto shorelines = dsas::load_shorelines_shp(dsas::options.shoreline_path,
-                                              dsas::options.date_field.c_str());
+  std::string prj;
+  auto shorelines = dsas::load_shorelines_shp(
+      dsas::options.shoreline_path, dsas::options.date_field.c_str(), &prj);
   auto transects = dsas::generate_transects(baselines);
 
-  std::vector<std::unique_ptr<dsas::IntersectPoint>> intersects;
-  if (dsas::options.build_index) {
-    auto grids = dsas::build_spatial_grids(shorelines, transects);
-    intersects = dsas::generate_intersects(transects, grids);
-  } else {
-    intersects = dsas::generate_intersects(transects, shorelines);
-  }
-
-  for (auto& transect : transects) {
-    if (!transect->intersects.empty()) {
-      transect->change_rate = dsas::linearRegressRate(transect->intersects);
-    }
-  }
-
-  auto prj = dsas::get_shp_proj(dsas::options.shoreline_path.c_str());
-  dsas::save_transect(transects, prj);
-  dsas::save_intersects(intersects, prj);
+  calculate_and_save(transects, shorelines, prj, stats);
 }
 
 void run_cast() {
-  auto baselines = dsas::load_baselines_shp(dsas::options.baseline_path,
-                                            dsas::options.baseline_id_field);
+  std::string prj;
+  auto baselines = dsas::load_baselines_shp(
+      dsas::options.baseline_path, dsas::options.baseline_id_field, &prj);
   auto transects = dsas::generate_transects(baselines);
-  auto prj = dsas::get_shp_proj(dsas::options.baseline_path.c_str());
   dsas::save_transect(transects, prj);
 }
 
-void run_cal() {
-  auto shorelines = dsas::load_shorelines_shp(dsas::options.shoreline_path,
-                                              dsas::options.date_field.c_str());
+void run_cal(dsas::ThreadStats& stats) {
+  std::string prj;
+  auto shorelines = dsas::load_shorelines_shp(
+      dsas::options.shoreline_path, dsas::options.date_field.c_str(), &prj);
   auto transects = dsas::load_transects_from_shp(dsas::options.transect_path);
 
-  auto prj = dsas::get_shp_proj(dsas::options.shoreline_path.c_str());
-
-  std::vector<std::unique_ptr<dsas::IntersectPoint>> intersects;
-  if (dsas::options.build_index) {
-    auto grids = dsas::build_spatial_grids(shorelines, transects);
-    intersects = dsas::generate_intersects(transects, grids);
-  } else {
-    intersects = dsas::generate_intersects(transects, shorelines);
-  }
-
-  for (auto& transect : transects) {
-    if (!transect->intersects.empty()) {
-      transect->change_rate = dsas::linearRegressRate(transect->intersects);
-    }
-  }
-  dsas::save_transect(transects, prj);
-  dsas::save_intersects(intersects, prj);
+  calculate_and_save(transects, shorelines, prj, stats);
 }
 }  // namespace
 
 int main(int argc, char* argv[]) {
   auto cli_status = dsas::parse_args(argc, argv);
+  dsas::ThreadStats thread_stats;
   switch (cli_status) {
     case dsas::CliStatus::Root:
-      run_root();
+      run_root(thread_stats);
       break;
     case dsas::CliStatus::Cast:
       run_cast();
       break;
     case dsas::CliStatus::Cal:
-      run_cal();
+      run_cal(thread_stats);
       break;
     default:
       exit(1);
   }
+  if (!dsas::diagnostics.empty()) {
+    std::cout << dsas::diagnostics << "\n";
+  }
+  if (dsas::options.thread_stats) {
+    std::cout << thread_stats;
+  }
   std::cout << "Calculation Done!\n";
   return 0;
 }
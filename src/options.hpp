@@ -15,6 +15,8 @@ struct Options {
 
   enum class IntersectionMode { Closest, Farthest };
   enum class TransectOrientation { Left, Right, Mix };
+  enum class SpatialIndex { Grid, RTree };
+  enum class GridSizing { Median, CostModel };
   int smooth_factor{1};
   double transect_length{500};
   double transect_spacing{30};
@@ -22,6 +24,11 @@ struct Options {
   TransectOrientation transect_orient{TransectOrientation::Mix};
 
   bool build_index = false;
+  SpatialIndex spatial_index{SpatialIndex::Grid};
+  GridSizing grid_sizing{GridSizing::Median};
+  bool thread_stats = false;  // print the per-thread busy time at the end
+  // with false only the rates are computed, no intersection table is kept
+  bool write_intersects = true;
 };
 
 extern Options options;
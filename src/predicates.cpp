@@ -0,0 +1,50 @@
+#include "predicates.hpp"
+
+#include <cmath>
+#include <cstddef>
+
+#include "diagnostics.hpp"
+
+namespace dsas {
+
+namespace {
+// a + b == sum + err exactly (Knuth's two-sum)
+void two_sum(double a, double b, double &sum, double &err) {
+  sum = a + b;
+  const double b_virtual = sum - a;
+  const double a_virtual = sum - b_virtual;
+  err = (a - a_virtual) + (b - b_virtual);
+}
+}  // namespace
+
+double orient2d_exact(double ax, double ay, double bx, double by, double cx,
+                      double cy) {
+  diagnostics.exact_orientations.fetch_add(1, std::memory_order_relaxed);
+
+  // the determinant expanded into six products (cx * cy cancels), each split
+  // exactly into product + rounding error and added to a nonoverlapping
+  // expansion of increasing magnitude (Shewchuk's grow_expansion)
+  const double factors[6][2] = {{ax, by},  {-ax, cy}, {-cx, by},
+                                {-ay, bx}, {ay, cx},  {cy, bx}};
+  double expansion[12];
+  size_t size = 0;
+  auto grow = [&](double value) {
+    size_t kept = 0;
+    for (size_t i = 0; i < size; ++i) {
+      double sum, err;
+      two_sum(value, expansion[i], sum, err);
+      if (err != 0) expansion[kept++] = err;
+      value = sum;
+    }
+    if (value != 0) expansion[kept++] = value;
+    size = kept;
+  };
+  for (const auto &[a, b] : factors) {
+    const double product = a * b;
+    grow(std::fma(a, b, -product));
+    grow(product);
+  }
+  return size == 0 ? 0.0 : expansion[size - 1];
+}
+
+}  // namespace dsas
@@ -0,0 +1,54 @@
+#ifndef SRC_PREDICATES_HPP_
+#define SRC_PREDICATES_HPP_
+
+#include <cmath>
+#include <limits>
+
+#include "geometry.hpp"
+
+namespace dsas {
+
+// Relative error bound of the floating-point orientation determinant
+// (Shewchuk's ccwerrboundA): when |det| exceeds it times
+// |detleft| + |detright|, det has the sign of the exact value.
+inline constexpr double orient2d_error_bound =
+    (3.0 + 8.0 * std::numeric_limits<double>::epsilon()) *
+    (std::numeric_limits<double>::epsilon() / 2);
+
+// (ax - cx) * (by - cy) - (ay - cy) * (bx - cx) evaluated exactly; the result
+// is the leading term of the exact value, so its sign is always right.
+// Counted in diagnostics.exact_orientations.
+double orient2d_exact(double ax, double ay, double bx, double by, double cx,
+                      double cy);
+
+// True when the floating-point det = detleft - detright is too close to zero
+// for its sign to be trusted. |detleft + detright| stands in for
+// |detleft| + |detright|: they differ only when the two have opposite signs,
+// and then det is never close to zero anyway.
+inline bool orient2d_uncertain(double detleft, double detright) {
+  return std::abs(detleft - detright) <=
+         orient2d_error_bound * std::abs(detleft + detright);
+}
+
+// Positive when a, b, c turn counter-clockwise, negative when clockwise and
+// zero when collinear. Plain floating point unless the result is too close
+// to zero to call, then exact.
+inline double orient2d(double ax, double ay, double bx, double by, double cx,
+                       double cy) {
+  const double detleft = (ax - cx) * (by - cy);
+  const double detright = (ay - cy) * (bx - cx);
+  if (!orient2d_uncertain(detleft, detright)) return detleft - detright;
+  return orient2d_exact(ax, ay, bx, by, cx, cy);
+}
+
+inline double orient2d(const Point &a, const Point &b, const Point &c) {
+  return orient2d(a.x, a.y, b.x, b.y, c.x, c.y);
+}
+
+// a * b <= 0, without a product that could underflow to zero
+inline bool opposite_signs(double a, double b) {
+  return !((a > 0 && b > 0) || (a < 0 && b < 0));
+}
+
+}  // namespace dsas
+#endif
@@ -0,0 +1,118 @@
+#include "rtree.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "exception.hpp"
+
+namespace dsas {
+
+namespace {
+// A segment with its bounding box, the input of the leaf level.
+struct SegBox {
+  double min_x, min_y, max_x, max_y;
+  SegRef seg;
+};
+
+// Orders boxes into Sort-Tile-Recursive tiles: sorted by x into vertical
+// slices of ceil(sqrt(parents)) parents each, then by y within a slice, so
+// every run of node_capacity consecutive boxes forms one compact parent.
+template <typename Box>
+void str_sort(std::vector<Box> &boxes) {
+  const size_t capacity = RTree::node_capacity;
+  const size_t num_parents = (boxes.size() + capacity - 1) / capacity;
+  const auto num_slices = static_cast<size_t>(
+      std::ceil(std::sqrt(static_cast<double>(num_parents))));
+  const size_t slice_size = num_slices * capacity;
+
+  std::sort(boxes.begin(), boxes.end(), [](const Box &a, const Box &b) {
+    return a.min_x + a.max_x < b.min_x + b.max_x;
+  });
+  for (size_t begin = 0; begin < boxes.size(); begin += slice_size) {
+    const size_t end = std::min(boxes.size(), begin + slice_size);
+    std::sort(boxes.begin() + begin, boxes.begin() + end,
+              [](const Box &a, const Box &b) {
+                return a.min_y + a.max_y < b.min_y + b.max_y;
+              });
+  }
+}
+
+// Node covering boxes[begin, end); first is left for the caller to set.
+template <typename Box>
+RTree::Node bound(const std::vector<Box> &boxes, size_t begin, size_t end) {
+  RTree::Node node{std::numeric_limits<double>::max(),
+                   std::numeric_limits<double>::max(),
+                   std::numeric_limits<double>::lowest(),
+                   std::numeric_limits<double>::lowest(), 0,
+                   static_cast<std::uint32_t>(end - begin)};
+  for (size_t k = begin; k < end; ++k) {
+    node.min_x = std::min(node.min_x, boxes[k].min_x);
+    node.min_y = std::min(node.min_y, boxes[k].min_y);
+    node.max_x = std::max(node.max_x, boxes[k].max_x);
+    node.max_y = std::max(node.max_y, boxes[k].max_y);
+  }
+  return node;
+}
+}  // namespace
+
+RTree build_shoreline_rtree(
+    const std::vector<std::unique_ptr<Shoreline>> &shorelines) {
+  RTree rtree;
+  rtree.assign(shorelines);
+
+  std::vector<SegBox> seg_boxes;
+  for (size_t si = 0; si < shorelines.size(); ++si) {
+    const auto &pts = shorelines[si]->shoreline_vertices_;
+    for (size_t j = 0; j + 1 < pts.size(); ++j) {
+      const auto &a = pts[j];
+      const auto &b = pts[j + 1];
+      seg_boxes.push_back(SegBox{std::min(a.x, b.x), std::min(a.y, b.y),
+                                 std::max(a.x, b.x), std::max(a.y, b.y),
+                                 SegRef{static_cast<std::uint32_t>(si),
+                                        static_cast<std::uint32_t>(j)}});
+    }
+  }
+  if (seg_boxes.empty()) return rtree;
+
+  // leaves: runs of the tiled segments
+  const size_t capacity = RTree::node_capacity;
+  str_sort(seg_boxes);
+  rtree.segs.reserve(seg_boxes.size());
+  for (const auto &box : seg_boxes) rtree.segs.push_back(box.seg);
+  std::vector<RTree::Node> level;
+  for (size_t begin = 0; begin < seg_boxes.size(); begin += capacity) {
+    auto node =
+        bound(seg_boxes, begin, std::min(seg_boxes.size(), begin + capacity));
+    node.first = static_cast<std::uint32_t>(begin);
+    level.push_back(node);
+  }
+  rtree.num_leaves = level.size();
+
+  // Each level is tiled before it is appended, so the children of a parent
+  // are contiguous; their own child ranges point one level down and stay put.
+  while (level.size() > 1) {
+    str_sort(level);
+    const size_t base = rtree.nodes.size();
+    if (base + level.size() > std::numeric_limits<std::uint32_t>::max()) {
+      OPENDSAS_THROW("Too many shoreline segments for the spatial index");
+    }
+    rtree.nodes.insert(rtree.nodes.end(), level.begin(), level.end());
+
+    std::vector<RTree::Node> parents;
+    for (size_t begin = 0; begin < level.size(); begin += capacity) {
+      auto node = bound(level, begin, std::min(level.size(), begin + capacity));
+      node.first = static_cast<std::uint32_t>(base + begin);
+      parents.push_back(node);
+    }
+    level = std::move(parents);
+  }
+  rtree.nodes.push_back(level.front());  // the root
+  return rtree;
+}
+}  // namespace dsas
@@ -0,0 +1,87 @@
+#ifndef SRC_RTREE_HPP_
+#define SRC_RTREE_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "shoreline.hpp"
+
+namespace dsas {
+
+// Static R-tree over the shoreline segments, bulk loaded with Sort-Tile-
+// Recursive packing. Nodes are stored level by level in one flat array,
+// leaves first and the root last; a leaf covers
+// segs[first .. first + count), an inner node nodes[first .. first + count).
+// Unlike the grid every segment is stored exactly once, so its cost does not
+// depend on how segment lengths are distributed.
+struct RTree : IndexedShorelines {
+  static constexpr std::uint32_t node_capacity = 16;
+
+  struct Node {
+    double min_x, min_y, max_x, max_y;
+    std::uint32_t first;
+    std::uint32_t count;
+  };
+
+  std::vector<Node> nodes;
+  std::vector<SegRef> segs;  // leaf entries in packed order
+  size_t num_leaves{0};      // nodes[0 .. num_leaves) are the leaves
+
+  [[nodiscard]] bool empty() const { return segs.empty(); }
+  [[nodiscard]] bool is_leaf(size_t node) const { return node < num_leaves; }
+
+  // Visits every segment stored in a leaf whose box is crossed by segment
+  // [a, b]; the caller runs the exact intersection test on them.
+  template <typename Visit>
+  void query(const Point &a, const Point &b, Visit &&visit) const {
+    if (nodes.empty()) return;
+    const double min_x = std::min(a.x, b.x), max_x = std::max(a.x, b.x);
+    const double min_y = std::min(a.y, b.y), max_y = std::max(a.y, b.y);
+    const double dx = b.x - a.x, dy = b.y - a.y;
+    auto crosses = [&](const Node &node) {
+      if (node.max_x < min_x || node.min_x > max_x || node.max_y < min_y ||
+          node.min_y > max_y) {
+        return false;
+      }
+      // the line misses the box when all four corners lie on one side of it
+      auto side = [&](double x, double y) {
+        return dx * (y - a.y) - dy * (x - a.x);
+      };
+      const double s0 = side(node.min_x, node.min_y);
+      const double s1 = side(node.max_x, node.min_y);
+      const double s2 = side(node.min_x, node.max_y);
+      const double s3 = side(node.max_x, node.max_y);
+      return !((s0 > 0 && s1 > 0 && s2 > 0 && s3 > 0) ||
+               (s0 < 0 && s1 < 0 && s2 < 0 && s3 < 0));
+    };
+
+    // depth first; at most node_capacity pending nodes per level and no more
+    // than eight levels for 32-bit references
+    std::uint32_t stack[node_capacity * 8];
+    size_t top = 0;
+    stack[top++] = static_cast<std::uint32_t>(nodes.size() - 1);
+    while (top > 0) {
+      const auto id = stack[--top];
+      const auto &node = nodes[id];
+      if (!crosses(node)) continue;
+      if (is_leaf(id)) {
+        for (std::uint32_t k = 0; k < node.count; ++k) {
+          visit(segs[node.first + k]);
+        }
+      } else {
+        for (std::uint32_t k = node.count; k-- > 0;) {
+          stack[top++] = node.first + k;
+        }
+      }
+    }
+  }
+};
+
+RTree build_shoreline_rtree(
+    const std::vector<std::unique_ptr<Shoreline>> &shorelines);
+
+}  // namespace dsas
+#endif
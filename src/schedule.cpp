@@ -0,0 +1,77 @@
+#include "schedule.hpp"
+
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <ostream>
+
+#include "exception.hpp"
+
+namespace dsas {
+
+double LoopBalance::max_seconds() const {
+  return busy_seconds.empty()
+             ? 0
+             : *std::max_element(busy_seconds.begin(), busy_seconds.end());
+}
+
+double LoopBalance::mean_seconds() const {
+  if (busy_seconds.empty()) return 0;
+  return std::accumulate(busy_seconds.begin(), busy_seconds.end(), 0.0) /
+         static_cast<double>(busy_seconds.size());
+}
+
+double LoopBalance::idle_share() const {
+  const double max = max_seconds();
+  return max > 0 ? 1 - mean_seconds() / max : 0;
+}
+
+namespace {
+void print_balance(std::ostream &os, const char *name,
+                   const LoopBalance &balance) {
+  os << name << ": " << balance.busy_seconds.size() << " threads, busiest "
+     << balance.max_seconds() << " s, mean " << balance.mean_seconds()
+     << " s, " << 100 * balance.idle_share() << "% idle\n";
+  for (size_t t = 0; t < balance.busy_seconds.size(); ++t) {
+    os << "  thread " << t << ": " << balance.busy_seconds[t] << " s\n";
+  }
+}
+}  // namespace
+
+std::ostream &operator<<(std::ostream &os, const ThreadStats &stats) {
+  os << "Thread balance\n";
+  if (!stats.transect_index.busy_seconds.empty()) {
+    print_balance(os, "build_transect_index", stats.transect_index);
+  }
+  if (!stats.intersects.busy_seconds.empty()) {
+    print_balance(os, "generate_intersects", stats.intersects);
+  }
+  if (!stats.rates.busy_seconds.empty()) {
+    print_balance(os, "change rates", stats.rates);
+  }
+  return os;
+}
+
+std::vector<std::uint32_t> order_by_cost(const std::vector<double> &costs) {
+  if (costs.size() > std::numeric_limits<std::uint32_t>::max()) {
+    OPENDSAS_THROW("Too many items to schedule");
+  }
+  // bucket b holds costs in [2^(b - 1), 2^b), bucket 0 everything below 1
+  constexpr int num_buckets = 64;
+  auto bucket_of = [](double cost) {
+    if (!(cost >= 1)) return 0;
+    return std::min(num_buckets - 1, std::ilogb(cost) + 1);
+  };
+  std::vector<size_t> starts(num_buckets + 1, 0);
+  for (const double cost : costs) ++starts[num_buckets - bucket_of(cost)];
+  std::partial_sum(starts.begin(), starts.end(), starts.begin());
+
+  std::vector<std::uint32_t> order(costs.size());
+  for (size_t i = 0; i < costs.size(); ++i) {
+    order[starts[num_buckets - 1 - bucket_of(costs[i])]++] =
+        static_cast<std::uint32_t>(i);
+  }
+  return order;
+}
+
+}  // namespace dsas
@@ -0,0 +1,100 @@
+#ifndef SRC_SCHEDULE_HPP_
+#define SRC_SCHEDULE_HPP_
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iosfwd>
+#include <vector>
+
+namespace dsas {
+
+// Time each thread spent working in one parallel loop; the gap between the
+// busiest thread and the others is time they sat idle at the loop's end.
+struct LoopBalance {
+  std::vector<double> busy_seconds;  // per thread
+
+  [[nodiscard]] double max_seconds() const;
+  [[nodiscard]] double mean_seconds() const;
+  // share of the threads' time spent waiting for the busiest one
+  [[nodiscard]] double idle_share() const;
+};
+
+// Balance of the last run of each scheduled loop, shown with --thread-stats;
+// filled by the passes it is handed to.
+struct ThreadStats {
+  LoopBalance transect_index;  // build_transect_index
+  LoopBalance intersects;      // generate_intersects
+  LoopBalance rates;           // generate_rates or set_change_rates
+};
+
+std::ostream &operator<<(std::ostream &os, const ThreadStats &stats);
+
+// The exception of the lowest item that threw in a parallel loop, kept to be
+// rethrown after the loop as a serial loop would have thrown it.
+struct FirstError {
+  size_t item;
+  std::exception_ptr error;
+
+  explicit FirstError(size_t n) : item(n) {}
+
+  // call from a catch block of item i
+  void capture(size_t i) {
+#pragma omp critical(dsas_first_error)
+    if (i < item) {
+      item = i;
+      error = std::current_exception();
+    }
+  }
+  void rethrow() const {
+    if (error) std::rethrow_exception(error);
+  }
+};
+
+// Order of [0, n) by decreasing cost, bucketed by powers of two (a counting
+// sort, so linear in n); items of the same bucket keep their order.
+std::vector<std::uint32_t> order_by_cost(const std::vector<double> &costs);
+
+// Runs body(i, thread) for every i in [0, n) in parallel, balanced by the
+// estimated cost(i) of each item: they are handed out in order of
+// decreasing cost, in small dynamic chunks, so the expensive ones start
+// first and the cheap ones fill the gaps at the end. thread is the OpenMP
+// thread number, below omp_get_max_threads(). The time each thread spent
+// in the loop goes to balance, if given.
+template <typename Cost, typename Body>
+void for_each_balanced(size_t n, Cost &&cost, Body &&body,
+                       LoopBalance *balance = nullptr) {
+  const auto total = static_cast<std::int64_t>(n);
+  std::vector<double> costs(n);
+#pragma omp parallel for schedule(static)
+  for (std::int64_t i = 0; i < total; i++) {
+    costs[i] = cost(static_cast<size_t>(i));
+  }
+  const auto order = order_by_cost(costs);
+
+  // chunks small enough to even out the tail, large enough to keep the
+  // shared loop counter from being hit once per item
+  const std::int64_t chunk =
+      std::max<std::int64_t>(1, total / (64 * omp_get_max_threads()));
+#pragma omp parallel
+  {
+    if (balance) {
+#pragma omp single
+      balance->busy_seconds.assign(omp_get_num_threads(), 0.0);
+    }
+
+    const int thread = omp_get_thread_num();
+    const double start = omp_get_wtime();
+#pragma omp for schedule(dynamic, chunk) nowait
+    for (std::int64_t k = 0; k < total; k++) {
+      body(static_cast<size_t>(order[k]), thread);
+    }
+    if (balance) balance->busy_seconds[thread] = omp_get_wtime() - start;
+  }
+}
+
+}  // namespace dsas
+#endif
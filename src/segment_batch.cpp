@@ -0,0 +1,431 @@
+#include "segment_batch.hpp"
+
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "diagnostics.hpp"
+#include "predicates.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define DSAS_BATCH_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define DSAS_BATCH_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace dsas {
+
+namespace {
+constexpr double parallel_tolerance = TransectConstants::parallel_tolerance;
+
+std::uint64_t lanes_in_use(size_t size) {
+  return size >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << size) - 1;
+}
+
+// Common tail of the vector kernels: drops the lanes beyond batch.size,
+// places the parallel crossings and redoes the lanes whose orientation signs
+// could not be trusted with exact predicates.
+void finish_batch(const TransectConstants &c, const SegmentBatch &batch,
+                  BatchHits &hits, std::uint64_t mask, std::uint64_t recheck,
+                  std::uint64_t parallel) {
+  const auto in_use = lanes_in_use(batch.size);
+  recheck &= in_use;
+  mask &= in_use & ~recheck;
+  for (auto lanes = mask & parallel; lanes != 0; lanes &= lanes - 1) {
+    const auto k = static_cast<size_t>(std::countr_zero(lanes));
+    hits.t[k] = parallel_crossing(c, batch.x0[k], batch.y0[k], batch.x1[k],
+                                  batch.y1[k]);
+  }
+  for (; recheck != 0; recheck &= recheck - 1) {
+    const auto k = static_cast<size_t>(std::countr_zero(recheck));
+    const auto crossing = intersect_segment_exact(
+        c, batch.x0[k], batch.y0[k], batch.x1[k], batch.y1[k]);
+    if (!crossing.hit) continue;
+    mask |= std::uint64_t{1} << k;
+    hits.t[k] = crossing.t;
+  }
+  hits.mask = mask;
+}
+
+// The vector kernels below compute intersect_segment lane by lane, without
+// the early exits but dividing only in vectors that hold a hit, and flag the
+// lanes that need one of its slow paths for finish_batch.
+void intersect_batch_scalar(const TransectConstants &c,
+                            const SegmentBatch &batch, BatchHits &hits) {
+  std::uint64_t mask = 0;
+  for (size_t k = 0; k < batch.size; k++) {
+    const auto crossing = intersect_segment(c, batch.x0[k], batch.y0[k],
+                                            batch.x1[k], batch.y1[k]);
+    if (!crossing.hit) continue;
+    mask |= std::uint64_t{1} << k;
+    hits.t[k] = crossing.t;
+  }
+  hits.mask = mask;
+}
+
+#if defined(DSAS_BATCH_X86)
+// orient2d_uncertain, lane by lane
+__attribute__((target("avx2"))) inline __m256d unsure256(
+    __m256d det, __m256d left, __m256d right, __m256d error_bound) {
+  const __m256d sign = _mm256_set1_pd(-0.0);
+  return _mm256_cmp_pd(
+      _mm256_andnot_pd(sign, det),
+      _mm256_mul_pd(error_bound,
+                    _mm256_andnot_pd(sign, _mm256_add_pd(left, right))),
+      _CMP_LE_OQ);
+}
+
+// both lanes > 0 or both < 0: the negation of opposite_signs, lane by lane
+__attribute__((target("avx2"))) inline __m256d same_signs256(__m256d a,
+                                                             __m256d b) {
+  const __m256d zero = _mm256_setzero_pd();
+  return _mm256_or_pd(_mm256_and_pd(_mm256_cmp_pd(a, zero, _CMP_GT_OQ),
+                                    _mm256_cmp_pd(b, zero, _CMP_GT_OQ)),
+                      _mm256_and_pd(_mm256_cmp_pd(a, zero, _CMP_LT_OQ),
+                                    _mm256_cmp_pd(b, zero, _CMP_LT_OQ)));
+}
+
+__attribute__((target("avx2"))) void intersect_batch_avx2(
+    const TransectConstants &c, const SegmentBatch &batch, BatchHits &hits) {
+  const __m256d ax = _mm256_set1_pd(c.ax), ay = _mm256_set1_pd(c.ay);
+  const __m256d bx = _mm256_set1_pd(c.bx), by = _mm256_set1_pd(c.by);
+  const __m256d dx = _mm256_set1_pd(c.dx), dy = _mm256_set1_pd(c.dy);
+  const __m256d ndx = _mm256_set1_pd(-c.dx), ndy = _mm256_set1_pd(-c.dy);
+  const __m256d min_x = _mm256_set1_pd(c.min_x);
+  const __m256d max_x = _mm256_set1_pd(c.max_x);
+  const __m256d min_y = _mm256_set1_pd(c.min_y);
+  const __m256d max_y = _mm256_set1_pd(c.max_y);
+  const __m256d tolerance = _mm256_set1_pd(parallel_tolerance);
+  const __m256d error_bound = _mm256_set1_pd(orient2d_error_bound);
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d sign = _mm256_set1_pd(-0.0);
+
+  std::uint64_t mask = 0, recheck = 0, parallel = 0;
+  for (size_t k = 0; k < batch.size; k += 4) {
+    const __m256d px = _mm256_load_pd(batch.x0 + k);
+    const __m256d py = _mm256_load_pd(batch.y0 + k);
+    const __m256d qx = _mm256_load_pd(batch.x1 + k);
+    const __m256d qy = _mm256_load_pd(batch.y1 + k);
+
+    // min and max with q first pick as std::min and std::max do on a NaN
+    __m256d box = _mm256_and_pd(
+        _mm256_cmp_pd(max_x, _mm256_min_pd(qx, px), _CMP_GE_OQ),
+        _mm256_cmp_pd(_mm256_max_pd(qx, px), min_x, _CMP_GE_OQ));
+    box = _mm256_and_pd(
+        box, _mm256_cmp_pd(_mm256_max_pd(qy, py), min_y, _CMP_GE_OQ));
+    box = _mm256_and_pd(
+        box, _mm256_cmp_pd(max_y, _mm256_min_pd(qy, py), _CMP_GE_OQ));
+
+    const __m256d sx = _mm256_sub_pd(qx, px), sy = _mm256_sub_pd(qy, py);
+    const __m256d l1 = _mm256_mul_pd(_mm256_sub_pd(ax, px), sy);
+    const __m256d r1 = _mm256_mul_pd(_mm256_sub_pd(ay, py), sx);
+    const __m256d l2 = _mm256_mul_pd(_mm256_sub_pd(bx, px), sy);
+    const __m256d r2 = _mm256_mul_pd(_mm256_sub_pd(by, py), sx);
+    const __m256d l3 = _mm256_mul_pd(_mm256_sub_pd(px, bx), ndy);
+    const __m256d r3 = _mm256_mul_pd(_mm256_sub_pd(py, by), ndx);
+    const __m256d l4 = _mm256_mul_pd(_mm256_sub_pd(qx, bx), ndy);
+    const __m256d r4 = _mm256_mul_pd(_mm256_sub_pd(qy, by), ndx);
+    const __m256d c1 = _mm256_sub_pd(l1, r1), c2 = _mm256_sub_pd(l2, r2);
+    const __m256d c3 = _mm256_sub_pd(l3, r3), c4 = _mm256_sub_pd(l4, r4);
+    const __m256d hit = _mm256_andnot_pd(
+        _mm256_or_pd(same_signs256(c1, c2), same_signs256(c3, c4)), box);
+
+    const __m256d uncertain = _mm256_or_pd(
+        _mm256_or_pd(unsure256(c1, l1, r1, error_bound),
+                     unsure256(c2, l2, r2, error_bound)),
+        _mm256_or_pd(unsure256(c3, l3, r3, error_bound),
+                     unsure256(c4, l4, r4, error_bound)));
+
+    recheck |= static_cast<std::uint64_t>(
+                   _mm256_movemask_pd(_mm256_and_pd(box, uncertain)))
+               << k;
+    const auto lanes = static_cast<std::uint64_t>(_mm256_movemask_pd(hit));
+    if (lanes == 0) continue;
+    mask |= lanes << k;
+
+    const __m256d den =
+        _mm256_sub_pd(_mm256_mul_pd(dx, sy), _mm256_mul_pd(dy, sx));
+    _mm256_store_pd(hits.t + k, _mm256_div_pd(_mm256_sub_pd(zero, c1), den));
+    parallel |= static_cast<std::uint64_t>(_mm256_movemask_pd(_mm256_cmp_pd(
+                    _mm256_andnot_pd(sign, den), tolerance, _CMP_LT_OQ)))
+                << k;
+  }
+  finish_batch(c, batch, hits, mask, recheck, parallel);
+}
+
+// orient2d_uncertain, lane by lane
+__attribute__((target("avx512f"))) inline __mmask8 unsure512(
+    __m512d det, __m512d left, __m512d right, __m512d error_bound) {
+  return _mm512_cmp_pd_mask(
+      _mm512_abs_pd(det),
+      _mm512_mul_pd(error_bound, _mm512_abs_pd(_mm512_add_pd(left, right))),
+      _CMP_LE_OQ);
+}
+
+// both lanes > 0 or both < 0: the negation of opposite_signs, lane by lane
+__attribute__((target("avx512f"))) inline __mmask8 same_signs512(__m512d a,
+                                                                 __m512d b) {
+  const __m512d zero = _mm512_setzero_pd();
+  return (_mm512_cmp_pd_mask(a, zero, _CMP_GT_OQ) &
+          _mm512_cmp_pd_mask(b, zero, _CMP_GT_OQ)) |
+         (_mm512_cmp_pd_mask(a, zero, _CMP_LT_OQ) &
+          _mm512_cmp_pd_mask(b, zero, _CMP_LT_OQ));
+}
+
+// std::min(a, b) and std::max(a, b), lane by lane, NaNs included
+__attribute__((target("avx512f"))) inline __m512d min512(__m512d a,
+                                                         __m512d b) {
+  return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(b, a, _CMP_LT_OQ), a, b);
+}
+__attribute__((target("avx512f"))) inline __m512d max512(__m512d a,
+                                                         __m512d b) {
+  return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(a, b, _CMP_LT_OQ), a, b);
+}
+
+__attribute__((target("avx512f"))) void intersect_batch_avx512(
+    const TransectConstants &c, const SegmentBatch &batch, BatchHits &hits) {
+  const __m512d ax = _mm512_set1_pd(c.ax), ay = _mm512_set1_pd(c.ay);
+  const __m512d bx = _mm512_set1_pd(c.bx), by = _mm512_set1_pd(c.by);
+  const __m512d dx = _mm512_set1_pd(c.dx), dy = _mm512_set1_pd(c.dy);
+  const __m512d ndx = _mm512_set1_pd(-c.dx), ndy = _mm512_set1_pd(-c.dy);
+  const __m512d min_x = _mm512_set1_pd(c.min_x);
+  const __m512d max_x = _mm512_set1_pd(c.max_x);
+  const __m512d min_y = _mm512_set1_pd(c.min_y);
+  const __m512d max_y = _mm512_set1_pd(c.max_y);
+  const __m512d tolerance = _mm512_set1_pd(parallel_tolerance);
+  const __m512d error_bound = _mm512_set1_pd(orient2d_error_bound);
+  const __m512d zero = _mm512_setzero_pd();
+
+  std::uint64_t mask = 0, recheck = 0, parallel = 0;
+  for (size_t k = 0; k < batch.size; k += 8) {
+    const __m512d px = _mm512_load_pd(batch.x0 + k);
+    const __m512d py = _mm512_load_pd(batch.y0 + k);
+    const __m512d qx = _mm512_load_pd(batch.x1 + k);
+    const __m512d qy = _mm512_load_pd(batch.y1 + k);
+
+    // min and max as blends: GCC 12 flags _mm512_min_pd as reading an
+    // uninitialized register
+    const __mmask8 box =
+        _mm512_cmp_pd_mask(max_x, min512(px, qx), _CMP_GE_OQ) &
+        _mm512_cmp_pd_mask(max512(px, qx), min_x, _CMP_GE_OQ) &
+        _mm512_cmp_pd_mask(max512(py, qy), min_y, _CMP_GE_OQ) &
+        _mm512_cmp_pd_mask(max_y, min512(py, qy), _CMP_GE_OQ);
+
+    const __m512d sx = _mm512_sub_pd(qx, px), sy = _mm512_sub_pd(qy, py);
+    const __m512d l1 = _mm512_mul_pd(_mm512_sub_pd(ax, px), sy);
+    const __m512d r1 = _mm512_mul_pd(_mm512_sub_pd(ay, py), sx);
+    const __m512d l2 = _mm512_mul_pd(_mm512_sub_pd(bx, px), sy);
+    const __m512d r2 = _mm512_mul_pd(_mm512_sub_pd(by, py), sx);
+    const __m512d l3 = _mm512_mul_pd(_mm512_sub_pd(px, bx), ndy);
+    const __m512d r3 = _mm512_mul_pd(_mm512_sub_pd(py, by), ndx);
+    const __m512d l4 = _mm512_mul_pd(_mm512_sub_pd(qx, bx), ndy);
+    const __m512d r4 = _mm512_mul_pd(_mm512_sub_pd(qy, by), ndx);
+    const __m512d c1 = _mm512_sub_pd(l1, r1), c2 = _mm512_sub_pd(l2, r2);
+    const __m512d c3 = _mm512_sub_pd(l3, r3), c4 = _mm512_sub_pd(l4, r4);
+    const __mmask8 hit =
+        box & ~(same_signs512(c1, c2) | same_signs512(c3, c4));
+
+    const __mmask8 uncertain = unsure512(c1, l1, r1, error_bound) |
+                               unsure512(c2, l2, r2, error_bound) |
+                               unsure512(c3, l3, r3, error_bound) |
+                               unsure512(c4, l4, r4, error_bound);
+
+    recheck |= static_cast<std::uint64_t>(box & uncertain) << k;
+    if (hit == 0) continue;
+    mask |= static_cast<std::uint64_t>(hit) << k;
+
+    const __m512d den =
+        _mm512_sub_pd(_mm512_mul_pd(dx, sy), _mm512_mul_pd(dy, sx));
+    _mm512_store_pd(hits.t + k, _mm512_div_pd(_mm512_sub_pd(zero, c1), den));
+    parallel |= static_cast<std::uint64_t>(_mm512_cmp_pd_mask(
+                    _mm512_abs_pd(den), tolerance, _CMP_LT_OQ))
+                << k;
+  }
+  finish_batch(c, batch, hits, mask, recheck, parallel);
+}
+#endif
+
+#if defined(DSAS_BATCH_NEON)
+void intersect_batch_neon(const TransectConstants &c,
+                          const SegmentBatch &batch, BatchHits &hits) {
+  const float64x2_t ax = vdupq_n_f64(c.ax), ay = vdupq_n_f64(c.ay);
+  const float64x2_t bx = vdupq_n_f64(c.bx), by = vdupq_n_f64(c.by);
+  const float64x2_t dx = vdupq_n_f64(c.dx), dy = vdupq_n_f64(c.dy);
+  const float64x2_t ndx = vdupq_n_f64(-c.dx), ndy = vdupq_n_f64(-c.dy);
+  const float64x2_t min_x = vdupq_n_f64(c.min_x);
+  const float64x2_t max_x = vdupq_n_f64(c.max_x);
+  const float64x2_t min_y = vdupq_n_f64(c.min_y);
+  const float64x2_t max_y = vdupq_n_f64(c.max_y);
+  const float64x2_t tolerance = vdupq_n_f64(parallel_tolerance);
+  const float64x2_t error_bound = vdupq_n_f64(orient2d_error_bound);
+  const float64x2_t zero = vdupq_n_f64(0.0);
+  // orient2d_uncertain, lane by lane
+  auto unsure = [&](float64x2_t det, float64x2_t left, float64x2_t right) {
+    return vcleq_f64(vabsq_f64(det),
+                     vmulq_f64(error_bound, vabsq_f64(vaddq_f64(left, right))));
+  };
+  // both lanes > 0 or both < 0: the negation of opposite_signs
+  auto same_signs = [&](float64x2_t a, float64x2_t b) {
+    return vorrq_u64(vandq_u64(vcgtq_f64(a, zero), vcgtq_f64(b, zero)),
+                     vandq_u64(vcltq_f64(a, zero), vcltq_f64(b, zero)));
+  };
+  // std::min(a, b) and std::max(a, b), NaNs included
+  auto min2 = [](float64x2_t a, float64x2_t b) {
+    return vbslq_f64(vcltq_f64(b, a), b, a);
+  };
+  auto max2 = [](float64x2_t a, float64x2_t b) {
+    return vbslq_f64(vcltq_f64(a, b), b, a);
+  };
+  auto bits = [](uint64x2_t lanes) {
+    return (vgetq_lane_u64(lanes, 0) & 1) | (vgetq_lane_u64(lanes, 1) & 2);
+  };
+
+  std::uint64_t mask = 0, recheck = 0, parallel = 0;
+  for (size_t k = 0; k < batch.size; k += 2) {
+    const float64x2_t px = vld1q_f64(batch.x0 + k);
+    const float64x2_t py = vld1q_f64(batch.y0 + k);
+    const float64x2_t qx = vld1q_f64(batch.x1 + k);
+    const float64x2_t qy = vld1q_f64(batch.y1 + k);
+
+    uint64x2_t box = vandq_u64(vcgeq_f64(max_x, min2(px, qx)),
+                               vcgeq_f64(max2(px, qx), min_x));
+    box = vandq_u64(box, vcgeq_f64(max2(py, qy), min_y));
+    box = vandq_u64(box, vcgeq_f64(max_y, min2(py, qy)));
+
+    const float64x2_t sx = vsubq_f64(qx, px), sy = vsubq_f64(qy, py);
+    const float64x2_t l1 = vmulq_f64(vsubq_f64(ax, px), sy);
+    const float64x2_t r1 = vmulq_f64(vsubq_f64(ay, py), sx);
+    const float64x2_t l2 = vmulq_f64(vsubq_f64(bx, px), sy);
+    const float64x2_t r2 = vmulq_f64(vsubq_f64(by, py), sx);
+    const float64x2_t l3 = vmulq_f64(vsubq_f64(px, bx), ndy);
+    const float64x2_t r3 = vmulq_f64(vsubq_f64(py, by), ndx);
+    const float64x2_t l4 = vmulq_f64(vsubq_f64(qx, bx), ndy);
+    const float64x2_t r4 = vmulq_f64(vsubq_f64(qy, by), ndx);
+    const float64x2_t c1 = vsubq_f64(l1, r1), c2 = vsubq_f64(l2, r2);
+    const float64x2_t c3 = vsubq_f64(l3, r3), c4 = vsubq_f64(l4, r4);
+    const uint64x2_t hit = vbicq_u64(
+        box, vorrq_u64(same_signs(c1, c2), same_signs(c3, c4)));
+    const uint64x2_t uncertain =
+        vorrq_u64(vorrq_u64(unsure(c1, l1, r1), unsure(c2, l2, r2)),
+                  vorrq_u64(unsure(c3, l3, r3), unsure(c4, l4, r4)));
+
+    recheck |= bits(vandq_u64(box, uncertain)) << k;
+    const auto lanes = bits(hit);
+    if (lanes == 0) continue;
+    mask |= lanes << k;
+
+    const float64x2_t den = vsubq_f64(vmulq_f64(dx, sy), vmulq_f64(dy, sx));
+    vst1q_f64(hits.t + k, vdivq_f64(vnegq_f64(c1), den));
+    parallel |= bits(vcltq_f64(vabsq_f64(den), tolerance)) << k;
+  }
+  finish_batch(c, batch, hits, mask, recheck, parallel);
+}
+#endif
+
+void run_kernel(BatchKernel kernel, const TransectConstants &c,
+                const SegmentBatch &batch, BatchHits &hits) {
+  switch (kernel) {
+#if defined(DSAS_BATCH_X86)
+    case BatchKernel::Avx2:
+      intersect_batch_avx2(c, batch, hits);
+      return;
+    case BatchKernel::Avx512:
+      intersect_batch_avx512(c, batch, hits);
+      return;
+#endif
+#if defined(DSAS_BATCH_NEON)
+    case BatchKernel::Neon:
+      intersect_batch_neon(c, batch, hits);
+      return;
+#endif
+    default:
+      intersect_batch_scalar(c, batch, hits);
+  }
+}
+
+BatchKernel detect_batch_kernel() {
+  if (batch_kernel_supported(BatchKernel::Avx512)) return BatchKernel::Avx512;
+  if (batch_kernel_supported(BatchKernel::Avx2)) return BatchKernel::Avx2;
+  if (batch_kernel_supported(BatchKernel::Neon)) return BatchKernel::Neon;
+  return BatchKernel::Scalar;
+}
+}  // namespace
+
+SegmentCrossing intersect_segment_exact(const TransectConstants &c, double px,
+                                        double py, double qx, double qy) {
+  const double c1 = orient2d(c.ax, c.ay, qx, qy, px, py);
+  const double c2 = orient2d(c.bx, c.by, qx, qy, px, py);
+  const double c3 = orient2d(px, py, c.ax, c.ay, c.bx, c.by);
+  const double c4 = orient2d(qx, qy, c.ax, c.ay, c.bx, c.by);
+  if (!(opposite_signs(c1, c2) && opposite_signs(c3, c4))) return {false, 0};
+
+  const double den = c.dx * (qy - py) - c.dy * (qx - px);
+  if (std::abs(den) < parallel_tolerance) {
+    return {true, parallel_crossing(c, px, py, qx, qy)};
+  }
+  return {true, -c1 / den};
+}
+
+double parallel_crossing(const TransectConstants &c, double px, double py,
+                         double qx, double qy) {
+  diagnostics.parallel_segments.fetch_add(1, std::memory_order_relaxed);
+  return overlap_midpoint(c, px, py, qx, qy);
+}
+
+bool batch_kernel_supported(BatchKernel kernel) {
+  switch (kernel) {
+    case BatchKernel::Scalar:
+      return true;
+#if defined(DSAS_BATCH_X86)
+    case BatchKernel::Avx2:
+      return __builtin_cpu_supports("avx2");
+    case BatchKernel::Avx512:
+      return __builtin_cpu_supports("avx512f");
+#endif
+#if defined(DSAS_BATCH_NEON)
+    case BatchKernel::Neon:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+const char *batch_kernel_name(BatchKernel kernel) {
+  switch (kernel) {
+    case BatchKernel::Scalar:
+      return "scalar";
+    case BatchKernel::Avx2:
+      return "avx2";
+    case BatchKernel::Avx512:
+      return "avx512";
+    case BatchKernel::Neon:
+      return "neon";
+  }
+  return "unknown";
+}
+
+BatchKernel default_batch_kernel() {
+  static const BatchKernel kernel = detect_batch_kernel();
+  return kernel;
+}
+
+void intersect_batch(const Point &start, const Point &end,
+                     const SegmentBatch &batch, BatchHits &hits) {
+  intersect_batch(default_batch_kernel(), start, end, batch, hits);
+}
+
+void intersect_batch(const TransectConstants &transect,
+                     const SegmentBatch &batch, BatchHits &hits) {
+  run_kernel(default_batch_kernel(), transect, batch, hits);
+}
+
+void intersect_batch(BatchKernel kernel, const Point &start, const Point &end,
+                     const SegmentBatch &batch, BatchHits &hits) {
+  run_kernel(kernel, TransectConstants(start, end), batch, hits);
+}
+
+}  // namespace dsas
@@ -0,0 +1,159 @@
+#ifndef SRC_SEGMENT_BATCH_HPP_
+#define SRC_SEGMENT_BATCH_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "geometry.hpp"
+#include "predicates.hpp"
+
+namespace dsas {
+
+// Endpoints of up to 64 segments in structure-of-arrays form, the input of
+// the batched intersection kernel. Segment k runs from (x0[k], y0[k]) to
+// (x1[k], y1[k]).
+struct SegmentBatch {
+  static constexpr size_t capacity = 64;
+
+  size_t size{0};
+  alignas(64) double x0[capacity]{};
+  alignas(64) double y0[capacity]{};
+  alignas(64) double x1[capacity]{};
+  alignas(64) double y1[capacity]{};
+
+  [[nodiscard]] bool empty() const { return size == 0; }
+  [[nodiscard]] bool full() const { return size == capacity; }
+  void clear() { size = 0; }
+  void push(const Point &start, const Point &end) {
+    x0[size] = start.x;
+    y0[size] = start.y;
+    x1[size] = end.x;
+    y1[size] = end.y;
+    ++size;
+  }
+};
+
+// Result of one transect against a SegmentBatch: bit k of mask is set when
+// segment k crosses the transect (same rule as isTwoSegmentIntersected, with
+// exact orientation signs), and only then t[k] is the crossing's position
+// along the transect, 0 at its start and 1 at its end. Where
+// computeIntersectPoint would fail (|cross| < 1e-4, e.g. a collinear overlap)
+// t[k] is the middle of the part of the segment that overlaps the transect.
+struct BatchHits {
+  std::uint64_t mask{0};
+  alignas(64) double t[SegmentBatch::capacity];
+};
+
+// Per-transect values shared by every segment tested against it.
+struct TransectConstants {
+  // below this |cross(transect, segment)| computeIntersectPoint gives up and
+  // overlap_midpoint stands in for the crossing
+  static constexpr double parallel_tolerance = 1e-4;
+
+  double ax, ay, bx, by;
+  double dx, dy;  // end - start
+  double min_x, max_x, min_y, max_y;
+  double inv_len2;
+
+  TransectConstants(const Point &start, const Point &end)
+      : ax(start.x),
+        ay(start.y),
+        bx(end.x),
+        by(end.y),
+        dx(end.x - start.x),
+        dy(end.y - start.y),
+        min_x(std::min(start.x, end.x)),
+        max_x(std::max(start.x, end.x)),
+        min_y(std::min(start.y, end.y)),
+        max_y(std::max(start.y, end.y)),
+        inv_len2(dx * dx + dy * dy > 0 ? 1 / (dx * dx + dy * dy) : 0) {}
+};
+
+// One lane of BatchHits for a single segment [p, q].
+struct SegmentCrossing {
+  bool hit;
+  double t;
+};
+
+// Position along the transect of the middle of the part of segment
+// [(px, py), (qx, qy)] that overlaps it, for (nearly) parallel crossings.
+inline double overlap_midpoint(const TransectConstants &c, double px,
+                               double py, double qx, double qy) {
+  const double tp = ((px - c.ax) * c.dx + (py - c.ay) * c.dy) * c.inv_len2;
+  const double tq = ((qx - c.ax) * c.dx + (qy - c.ay) * c.dy) * c.inv_len2;
+  return (std::max(0.0, std::min(tp, tq)) + std::min(1.0, std::max(tp, tq))) *
+         0.5;
+}
+
+// The rare cases of intersect_segment, kept out of line: a segment that
+// passed the bbox test but whose orientations are too close to zero to
+// trust, tested again with exact predicates; and the position of a crossing
+// whose lines are (nearly) parallel, counted in diagnostics.
+SegmentCrossing intersect_segment_exact(const TransectConstants &c, double px,
+                                        double py, double qx, double qy);
+double parallel_crossing(const TransectConstants &c, double px, double py,
+                         double qx, double qy);
+
+// Tests segment [(px, py), (qx, qy)] against the transect in one pass: the
+// bbox overlap and the four orientations of isTwoSegmentIntersected, then t
+// from the same values.
+inline SegmentCrossing intersect_segment(const TransectConstants &c, double px,
+                                         double py, double qx, double qy) {
+  if (!(c.max_x >= std::min(px, qx) && std::max(px, qx) >= c.min_x &&
+        std::max(py, qy) >= c.min_y && c.max_y >= std::min(py, qy))) {
+    return {false, 0};
+  }
+  // each orientation as left - right
+  const double sx = qx - px, sy = qy - py;
+  const double l1 = (c.ax - px) * sy, r1 = (c.ay - py) * sx;
+  const double l2 = (c.bx - px) * sy, r2 = (c.by - py) * sx;
+  const double l3 = (px - c.bx) * -c.dy, r3 = (py - c.by) * -c.dx;
+  const double l4 = (qx - c.bx) * -c.dy, r4 = (qy - c.by) * -c.dx;
+  if (orient2d_uncertain(l1, r1) | orient2d_uncertain(l2, r2) |
+      orient2d_uncertain(l3, r3) | orient2d_uncertain(l4, r4)) [[unlikely]] {
+    return intersect_segment_exact(c, px, py, qx, qy);
+  }
+  const double c1 = l1 - r1;
+  if (!(opposite_signs(c1, l2 - r2) && opposite_signs(l3 - r3, l4 - r4))) {
+    return {false, 0};
+  }
+
+  const double den = c.dx * sy - c.dy * sx;
+  if (std::abs(den) < TransectConstants::parallel_tolerance) [[unlikely]] {
+    return {true, parallel_crossing(c, px, py, qx, qy)};
+  }
+  return {true, -c1 / den};
+}
+
+inline SegmentCrossing intersect_segment(const TransectConstants &c,
+                                         const Point &p, const Point &q) {
+  return intersect_segment(c, p.x, p.y, q.x, q.y);
+}
+
+enum class BatchKernel { Scalar, Avx2, Avx512, Neon };
+
+[[nodiscard]] bool batch_kernel_supported(BatchKernel kernel);
+[[nodiscard]] const char *batch_kernel_name(BatchKernel kernel);
+
+// Widest kernel the running CPU supports, detected once.
+[[nodiscard]] BatchKernel default_batch_kernel();
+
+// Tests transect [start, end] against every segment of the batch, with the
+// default kernel or a given one (which must be supported); the transect may
+// also come as precomputed constants.
+void intersect_batch(const Point &start, const Point &end,
+                     const SegmentBatch &batch, BatchHits &hits);
+void intersect_batch(const TransectConstants &transect,
+                     const SegmentBatch &batch, BatchHits &hits);
+void intersect_batch(BatchKernel kernel, const Point &start, const Point &end,
+                     const SegmentBatch &batch, BatchHits &hits);
+
+// Point at position t along [start, end].
+inline Point point_along(const Point &start, const Point &end, double t) {
+  return {start.x + t * (end.x - start.x), start.y + t * (end.y - start.y)};
+}
+
+}  // namespace dsas
+#endif
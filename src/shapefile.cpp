@@ -0,0 +1,302 @@
+#include "shapefile.hpp"
+
+#include <shapefil.h>
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "exception.hpp"
+
+namespace dsas {
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::filesystem::path &path) {
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    OPENDSAS_THROW("Cannot open: " + path.string());
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    CloseHandle(file);
+    OPENDSAS_THROW("Cannot read the size of: " + path.string());
+  }
+  file_ = file;
+  size_ = static_cast<size_t>(size.QuadPart);
+  if (size_ == 0) return;  // an empty file cannot be mapped
+  mapping_ = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  const void *view =
+      mapping_ ? MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+  if (!view) {
+    if (mapping_) CloseHandle(mapping_);
+    CloseHandle(file);
+    OPENDSAS_THROW("Cannot map: " + path.string());
+  }
+  data_ = static_cast<const unsigned char *>(view);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) UnmapViewOfFile(data_);
+  if (mapping_) CloseHandle(mapping_);
+  if (file_) CloseHandle(file_);
+}
+#else
+MappedFile::MappedFile(const std::filesystem::path &path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) OPENDSAS_THROW("Cannot open: " + path.string());
+  struct stat st {};
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    OPENDSAS_THROW("Cannot read the size of: " + path.string());
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  if (size_ > 0) {  // an empty file cannot be mapped
+    void *view = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED) {
+      close(fd);
+      OPENDSAS_THROW("Cannot map: " + path.string());
+    }
+    data_ = static_cast<const unsigned char *>(view);
+  }
+  close(fd);  // the mapping keeps the file open
+}
+
+MappedFile::~MappedFile() {
+  if (data_) munmap(const_cast<unsigned char *>(data_), size_);
+}
+#endif
+
+namespace {
+// value of type T stored at p in the given byte order
+template <typename T>
+T load(const unsigned char *p, std::endian order) {
+  unsigned char bytes[sizeof(T)];
+  std::memcpy(bytes, p, sizeof(T));
+  if (order != std::endian::native) std::reverse(bytes, bytes + sizeof(T));
+  T value;
+  std::memcpy(&value, bytes, sizeof(T));
+  return value;
+}
+
+std::int32_t load_be32(const unsigned char *p) {
+  return load<std::int32_t>(p, std::endian::big);
+}
+std::int32_t load_le32(const unsigned char *p) {
+  return load<std::int32_t>(p, std::endian::little);
+}
+// unsigned 32-bit counts and offsets
+size_t load_be_size(const unsigned char *p) {
+  return load<std::uint32_t>(p, std::endian::big);
+}
+size_t load_le_size(const unsigned char *p) {
+  return load<std::uint32_t>(p, std::endian::little);
+}
+double load_le64f(const unsigned char *p) {
+  return load<double>(p, std::endian::little);
+}
+
+// path with another extension, in lower or upper case as it exists
+std::filesystem::path sidecar(const std::filesystem::path &shp_path,
+                              const char *lower, const char *upper) {
+  auto path = shp_path;
+  path.replace_extension(lower);
+  if (std::filesystem::exists(path)) return path;
+  path.replace_extension(upper);
+  if (std::filesystem::exists(path)) return path;
+  path.replace_extension(lower);
+  return path;  // missing either way: reported by MappedFile
+}
+
+constexpr size_t kMainHeaderSize = 100;       // .shp and .shx
+constexpr size_t kRecordHeaderSize = 8;       // .shp record number and length
+constexpr size_t kIndexEntrySize = 8;         // .shx offset and length
+constexpr size_t kPointSize = 20;             // type, x, y
+constexpr size_t kMultiPointHeaderSize = 40;  // type, box, point count
+constexpr size_t kPolylineHeaderSize = 44;    // type, box, part/point counts
+constexpr size_t kDbfFieldSize = 32;          // .dbf field descriptor
+
+// How the x and y of a shape type are laid out in its record.
+enum class Layout { Point, MultiPoint, Parts, MultiPatch, Unsupported };
+
+Layout layout_of(int shape_type) {
+  switch (shape_type) {
+    case SHPT_POINT:
+    case SHPT_POINTZ:
+    case SHPT_POINTM:
+      return Layout::Point;
+    case SHPT_MULTIPOINT:
+    case SHPT_MULTIPOINTZ:
+    case SHPT_MULTIPOINTM:
+      return Layout::MultiPoint;
+    case SHPT_ARC:
+    case SHPT_ARCZ:
+    case SHPT_ARCM:
+    case SHPT_POLYGON:
+    case SHPT_POLYGONZ:
+    case SHPT_POLYGONM:
+      return Layout::Parts;
+    case SHPT_MULTIPATCH:
+      return Layout::MultiPatch;
+    default:
+      return Layout::Unsupported;
+  }
+}
+}  // namespace
+
+ShapefileReader::ShapefileReader(const std::filesystem::path &shp_path)
+    : shp_(shp_path),
+      shx_(sidecar(shp_path, ".shx", ".SHX")),
+      dbf_(sidecar(shp_path, ".dbf", ".DBF")) {
+  if (shp_.size() < kMainHeaderSize || shx_.size() < kMainHeaderSize ||
+      load_be32(shp_.data()) != 9994) {
+    OPENDSAS_THROW("Not a shapefile: " + shp_path.string());
+  }
+  num_records_ = (shx_.size() - kMainHeaderSize) / kIndexEntrySize;
+
+  // .dbf: 32-byte header, then 32-byte field descriptors up to 0x0D
+  if (dbf_.size() < kDbfFieldSize) {
+    OPENDSAS_THROW("Not a DBF file: " + shp_path.string());
+  }
+  const unsigned char *dbf = dbf_.data();
+  dbf_num_records_ = load_le_size(dbf + 4);
+  dbf_header_size_ = static_cast<size_t>(dbf[8]) | (size_t{dbf[9]} << 8);
+  dbf_record_size_ = static_cast<size_t>(dbf[10]) | (size_t{dbf[11]} << 8);
+  size_t offset = 1;  // past the deletion flag
+  for (size_t at = kDbfFieldSize;
+       at + kDbfFieldSize <= std::min(dbf_header_size_, dbf_.size()) &&
+       dbf[at] != 0x0D;
+       at += kDbfFieldSize) {
+    const auto *name = reinterpret_cast<const char *>(dbf + at);
+    const size_t width = dbf[at + 16];
+    fields_.push_back(Field{std::string(name, strnlen(name, 11)), offset,
+                            width});
+    offset += width;
+  }
+  if (offset > dbf_record_size_ ||
+      dbf_header_size_ + dbf_num_records_ * dbf_record_size_ > dbf_.size()) {
+    OPENDSAS_THROW("Truncated DBF file: " + shp_path.string());
+  }
+}
+
+void ShapefileReader::read(size_t i, ShapeRecord &record) const {
+  record.points.clear();
+  record.parts.clear();
+  record.shape_type = SHPT_NULL;
+  if (i >= num_records_) OPENDSAS_THROW("Shapefile record out of range");
+
+  // .shx offsets and lengths count 16-bit words
+  const unsigned char *entry =
+      shx_.data() + kMainHeaderSize + i * kIndexEntrySize;
+  const size_t start = 2 * load_be_size(entry) + kRecordHeaderSize;
+  const size_t length = 2 * load_be_size(entry + 4);
+  if (length < 4) return;  // nothing but an empty record
+  if (start + length > shp_.size()) {
+    OPENDSAS_THROW("Corrupt shapefile record " + std::to_string(i));
+  }
+  const unsigned char *content = shp_.data() + start;
+  record.shape_type = load_le32(content);
+  if (record.shape_type == SHPT_NULL) return;
+  const Layout layout = layout_of(record.shape_type);
+  if (layout == Layout::Unsupported) {
+    OPENDSAS_THROW("Unsupported shape type " +
+                   std::to_string(record.shape_type) + " in shapefile record " +
+                   std::to_string(i));
+  }
+  if (layout == Layout::Point) {
+    if (length < kPointSize) {
+      OPENDSAS_THROW("Corrupt shapefile record " + std::to_string(i));
+    }
+    record.points.emplace_back(load_le64f(content + 4),
+                               load_le64f(content + 12));
+    return;
+  }
+
+  // the others: bounding box, [part count,] point count, [part starts,
+  // [part types,]] then the points
+  const size_t header_size = layout == Layout::MultiPoint
+                                 ? kMultiPointHeaderSize
+                                 : kPolylineHeaderSize;
+  if (length < header_size) {
+    OPENDSAS_THROW("Corrupt shapefile record " + std::to_string(i));
+  }
+  const size_t num_parts =
+      layout == Layout::MultiPoint ? 0 : load_le_size(content + 36);
+  const size_t num_points = load_le_size(content + header_size - 4);
+  const size_t words_per_part = layout == Layout::MultiPatch ? 2 : 1;
+  const unsigned char *parts = content + header_size;
+  const unsigned char *xy = parts + 4 * words_per_part * num_parts;
+  if (num_parts > length || num_points > length ||
+      header_size + 4 * words_per_part * num_parts + 16 * num_points >
+          length) {
+    OPENDSAS_THROW("Corrupt shapefile record " + std::to_string(i));
+  }
+
+  record.parts.reserve(num_parts);
+  for (size_t p = 0; p < num_parts; ++p) {
+    const size_t first = load_le_size(parts + 4 * p);
+    if (first > num_points || (p > 0 && first < record.parts.back())) {
+      OPENDSAS_THROW("Corrupt shapefile record " + std::to_string(i));
+    }
+    record.parts.push_back(first);
+  }
+  record.points.reserve(num_points);
+  for (size_t k = 0; k < num_points; ++k) {
+    record.points.emplace_back(load_le64f(xy + 16 * k),
+                               load_le64f(xy + 16 * k + 8));
+  }
+}
+
+int ShapefileReader::field_index(std::string_view name) const {
+  auto same = [](std::string_view a, std::string_view b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                      [](unsigned char x, unsigned char y) {
+                        return std::toupper(x) == std::toupper(y);
+                      });
+  };
+  for (size_t f = 0; f < fields_.size(); ++f) {
+    if (same(fields_[f].name, name)) return static_cast<int>(f);
+  }
+  return -1;
+}
+
+std::string_view ShapefileReader::string_attribute(size_t i,
+                                                   int field) const {
+  if (i >= dbf_num_records_ || field < 0 ||
+      static_cast<size_t>(field) >= fields_.size()) {
+    OPENDSAS_THROW("DBF attribute out of range");
+  }
+  const auto &f = fields_[field];
+  const auto *value = reinterpret_cast<const char *>(
+      dbf_.data() + dbf_header_size_ + i * dbf_record_size_ + f.offset);
+  std::string_view text(value, f.width);
+  const auto first = text.find_first_not_of(' ');
+  if (first == std::string_view::npos) return {};
+  text = text.substr(first, text.find_last_not_of(' ') - first + 1);
+  // shapelib stops a value at its first NUL
+  return text.substr(0, text.find('\0'));
+}
+
+int ShapefileReader::integer_attribute(size_t i, int field) const {
+  const auto text = string_attribute(i, field);
+  double value = 0;
+  std::from_chars(text.data(), text.data() + text.size(), value);
+  return static_cast<int>(value);
+}
+
+}  // namespace dsas
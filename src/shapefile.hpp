@@ -0,0 +1,148 @@
+#ifndef SRC_SHAPEFILE_HPP_
+#define SRC_SHAPEFILE_HPP_
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "geometry.hpp"
+#include "schedule.hpp"
+
+namespace dsas {
+
+// A whole file mapped read-only into memory.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::filesystem::path &path);
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  [[nodiscard]] const unsigned char *data() const { return data_; }
+  [[nodiscard]] size_t size() const { return size_; }
+
+ private:
+  const unsigned char *data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  void *file_ = nullptr;     // HANDLE
+  void *mapping_ = nullptr;  // HANDLE
+#endif
+};
+
+// Geometry of one shapefile record: its vertices, one part after another,
+// and where each part starts. Points and multipoints have no parts.
+struct ShapeRecord {
+  int shape_type = 0;  // SHPT_* code; SHPT_NULL for an empty record
+  std::vector<Point> points;
+  std::vector<size_t> parts;
+
+  [[nodiscard]] size_t num_parts() const { return parts.size(); }
+  [[nodiscard]] std::span<const Point> part(size_t k) const {
+    const size_t last = k + 1 < parts.size() ? parts[k + 1] : points.size();
+    return {points.data() + parts[k], last - parts[k]};
+  }
+};
+
+// Reads a shapefile (.shp, with its .shx index and .dbf attributes) straight
+// from memory-mapped files: records are found through the .shx offsets and
+// decoded from the mapped pages, with no per-record allocation beyond the
+// reused ShapeRecord. Every shape type keeps the x and y of its vertices, as
+// shapelib reads them; Z and M values are skipped. Throws DSASError if a
+// file is missing, a record runs past the end of its file or has a shape
+// type the format does not define.
+class ShapefileReader {
+ public:
+  explicit ShapefileReader(const std::filesystem::path &shp_path);
+
+  // number of records
+  [[nodiscard]] size_t size() const { return num_records_; }
+
+  // Decodes record i into record; points and parts are left empty for a
+  // null shape.
+  void read(size_t i, ShapeRecord &record) const;
+
+  // index of the .dbf field with this name, ignoring case, or -1
+  [[nodiscard]] int field_index(std::string_view name) const;
+  // value of field of record i without its padding spaces
+  [[nodiscard]] std::string_view string_attribute(size_t i, int field) const;
+  // value of a numeric field of record i, truncated; 0 if blank
+  [[nodiscard]] int integer_attribute(size_t i, int field) const;
+
+ private:
+  struct Field {
+    std::string name;
+    size_t offset;  // from the start of a record
+    size_t width;
+  };
+
+  MappedFile shp_;
+  MappedFile shx_;
+  MappedFile dbf_;
+  size_t num_records_ = 0;
+  std::vector<Field> fields_;
+  size_t dbf_header_size_ = 0;
+  size_t dbf_record_size_ = 0;
+  size_t dbf_num_records_ = 0;
+};
+
+// Decodes every record of shapefile in parallel: decode(i, record, out)
+// appends what record i yields to out. The records are split into
+// contiguous ranges, several per thread so uneven records even out, each
+// decoded into its own Out, returned in record order. If records throw,
+// the lowest one's exception is rethrown.
+template <typename Out, typename Decode>
+std::vector<Out> read_record_ranges(const ShapefileReader &shapefile,
+                                    Decode &&decode) {
+  const size_t n = shapefile.size();
+  const auto num_ranges = static_cast<std::int64_t>(
+      std::min<size_t>(n, 8 * static_cast<size_t>(omp_get_max_threads())));
+  std::vector<Out> ranges(num_ranges);
+  FirstError first_error(n);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (std::int64_t r = 0; r < num_ranges; r++) {
+    ShapeRecord record;  // reused by the records of the range
+    const size_t first = n * r / num_ranges;
+    const size_t last = n * (r + 1) / num_ranges;
+    for (size_t i = first; i < last; ++i) {
+      try {
+        shapefile.read(i, record);
+        decode(i, record, ranges[r]);
+      } catch (...) {
+        first_error.capture(i);
+        break;
+      }
+    }
+  }
+  first_error.rethrow();
+  return ranges;
+}
+
+// read_record_ranges into vectors of T, joined in record order, so the
+// result is the same as a serial loop's.
+template <typename T, typename Decode>
+std::vector<T> read_records(const ShapefileReader &shapefile,
+                            Decode &&decode) {
+  auto ranges = read_record_ranges<std::vector<T>>(
+      shapefile, std::forward<Decode>(decode));
+  size_t total = 0;
+  for (const auto &range : ranges) total += range.size();
+  std::vector<T> out;
+  out.reserve(total);
+  for (auto &range : ranges) {
+    std::move(range.begin(), range.end(), std::back_inserter(out));
+  }
+  return out;
+}
+
+}  // namespace dsas
+#endif
@@ -2,11 +2,13 @@
 
 #include <shapefil.h>
 
+#include <omp.h>
+
 #include <algorithm>
+#include <cctype>
 #include <ctime>
-#include <fstream>
 #include <iostream>
-#include <nlohmann/json.hpp>
+#include <limits>
 
 #ifndef _WIN32
 #include <cstring>  // memset — ensure tm is clean before strptime
@@ -16,163 +18,252 @@
 #endif
 
 #include "exception.hpp"
+#include "geojson.hpp"
+#include "shapefile.hpp"
+#include "utility.hpp"
 
 namespace dsas {
 
 double mean_shore_segment = 0;
 
-Date generate_date_from_str(const char *date_str) {
-  auto format = dsas::options.date_format;
+void IndexedShorelines::assign(
+    const std::vector<std::unique_ptr<Shoreline>> &all) {
+  if (all.size() > std::numeric_limits<std::uint32_t>::max()) {
+    OPENDSAS_THROW("Too many shorelines for the spatial index");
+  }
+  shorelines.clear();
+  first_segment_id.clear();
+  shorelines.reserve(all.size());
+  first_segment_id.reserve(all.size());
+  std::uint64_t num_ids = 0;
+  for (const auto &shoreline : all) {
+    shorelines.push_back(shoreline.get());
+    first_segment_id.push_back(static_cast<std::uint32_t>(num_ids));
+    num_ids += shoreline->size();
+    if (num_ids > std::numeric_limits<std::uint32_t>::max()) {
+      OPENDSAS_THROW("Too many shoreline vertices for the spatial index");
+    }
+  }
+}
+
+void Shoreline::compute_envelopes() {
+  envelope_ = Envelope{};
+  chunk_envelopes_.clear();
+  const size_t n = num_segments();
+  chunk_envelopes_.reserve((n + chunk_segments - 1) / chunk_segments);
+  for (size_t first = 0; first < n; first += chunk_segments) {
+    // chunk segments [first, last) span vertices [first, last]
+    const size_t last = std::min(n, first + chunk_segments);
+    Envelope chunk;
+    for (size_t i = first; i <= last; ++i) chunk.expand(shoreline_vertices_[i]);
+    chunk_envelopes_.push_back(chunk);
+  }
+  for (const auto &vertex : shoreline_vertices_) envelope_.expand(vertex);
+}
+
+DateParser::DateParser(std::string format) : format_(std::move(format)) {
+  // compile the fast path: %Y, %m, %d and literal separators only
+  for (size_t i = 0; i < format_.size(); ++i) {
+    const char c = format_[i];
+    if (c != '%') {
+      // whitespace in a format matches any run of it: leave to strptime
+      if (std::isspace(static_cast<unsigned char>(c))) {
+        tokens_.clear();
+        return;
+      }
+      tokens_.push_back({Field::Literal, c});
+      continue;
+    }
+    const char spec = i + 1 < format_.size() ? format_[++i] : '\0';
+    if (spec == 'Y') {
+      tokens_.push_back({Field::Year, 0});
+    } else if (spec == 'm') {
+      tokens_.push_back({Field::Month, 0});
+    } else if (spec == 'd') {
+      tokens_.push_back({Field::Day, 0});
+    } else {
+      tokens_.clear();
+      return;
+    }
+  }
+}
+
+Date DateParser::parse(std::string_view text) {
+  // the hand-written path is cheaper than a cache lookup
+  if (const auto date = parse_numeric(text)) return *date;
+  if (!last_text_.empty() && text == last_text_) return last_date_;
+  std::string key(text);
+  auto it = cache_.find(key);
+  if (it == cache_.end()) {
+    const Date date = parse_strptime(key);
+    if (cache_.size() >= max_cached) cache_.clear();
+    it = cache_.emplace(std::move(key), date).first;
+  }
+  last_text_ = it->first;
+  last_date_ = it->second;
+  return last_date_;
+}
+
+// The numbers as strptime reads them: up to 4 digits for %Y and 2 for %m
+// and %d, within range. Anything else is left to strptime to accept or
+// reject, so both paths agree.
+std::optional<Date> DateParser::parse_numeric(std::string_view text) const {
+  if (tokens_.empty()) return std::nullopt;
+  Date date{1900, 1, 0};  // what strptime leaves in an unset field
+  size_t at = 0;
+  auto number = [&](size_t max_digits, int min, int max, int &out) {
+    int value = 0;
+    size_t digits = 0;
+    while (digits < max_digits && at < text.size() &&
+           text[at] >= '0' && text[at] <= '9') {
+      value = 10 * value + (text[at++] - '0');
+      ++digits;
+    }
+    if (digits == 0 || value < min || value > max) return false;
+    out = value;
+    return true;
+  };
+  for (const auto &token : tokens_) {
+    bool ok = true;
+    switch (token.field) {
+      case Field::Year:
+        ok = number(4, 0, 9999, date.year_);
+        break;
+      case Field::Month:
+        ok = number(2, 1, 12, date.month_);
+        break;
+      case Field::Day:
+        ok = number(2, 1, 31, date.day_);
+        break;
+      case Field::Literal:
+        ok = at < text.size() && text[at++] == token.literal;
+        break;
+    }
+    if (!ok) return std::nullopt;
+  }
+  if (at != text.size()) return std::nullopt;
+  return date;
+}
+
+Date DateParser::parse_strptime(const std::string &text) const {
   std::tm tm{};
 #ifndef _WIN32
   // strptime is POSIX: reliable %b/%B/%y support with correct century pivot
-  const char *end = strptime(date_str, format.c_str(), &tm);
+  const char *end = strptime(text.c_str(), format_.c_str(), &tm);
   if (end == nullptr || *end != '\0') {
-    OPENDSAS_THROW("Failed to parse date: " + std::string(date_str) +
-                   " using format: " + format);
+    OPENDSAS_THROW("Failed to parse date: " + text +
+                   " using format: " + format_);
   }
 #else
-  std::istringstream ss(date_str);
+  std::istringstream ss(text);
   ss.imbue(std::locale::classic());
-  ss >> std::get_time(&tm, format.c_str());
+  ss >> std::get_time(&tm, format_.c_str());
   if (ss.fail()) {
-    OPENDSAS_THROW("Failed to parse date: " + std::string(date_str) +
-                   " using format: " + format);
+    OPENDSAS_THROW("Failed to parse date: " + text +
+                   " using format: " + format_);
   }
 #endif
   return Date{tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday};
 }
 
+Date generate_date_from_str(const char *date_str) {
+  return DateParser(options.date_format).parse(date_str);
+}
+
 // ---- GeoJSON reader ----
 
 static std::vector<std::unique_ptr<Shoreline>> load_shorelines_geojson(
-    const std::filesystem::path &path, const char *date_field_name) {
-  std::ifstream f(path);
-  if (!f) OPENDSAS_THROW("Cannot open: " + path.string());
-  auto j = nlohmann::json::parse(f);
-
+    const std::filesystem::path &path, const char *date_field_name,
+    std::string *prj) {
   std::vector<std::unique_ptr<Shoreline>> shorelines;
   int shoreline_id = 0;
 
-  // Case-insensitive property lookup helper
-  auto get_prop = [](const nlohmann::json &props,
-                     const std::string &name) -> std::string {
-    std::string lower_name = name;
-    std::transform(lower_name.begin(), lower_name.end(), lower_name.begin(),
-                   ::tolower);
-    for (auto &[k, v] : props.items()) {
+  std::string lower_name = date_field_name;
+  std::transform(lower_name.begin(), lower_name.end(), lower_name.begin(),
+                 ::tolower);
+  // Case-insensitive property lookup
+  auto get_date = [&](const GeoJsonFeature &feature) -> std::string_view {
+    for (const auto &[k, v] : feature.properties) {
       std::string lk = k;
       std::transform(lk.begin(), lk.end(), lk.begin(), ::tolower);
-      if (lk == lower_name) return v.get<std::string>();
+      if (lk == lower_name) return v.get_ref<const std::string &>();
     }
-    OPENDSAS_THROW("Date field '" + name + "' not found in shoreline feature");
+    OPENDSAS_THROW("Date field '" + std::string(date_field_name) +
+                   "' not found in shoreline feature");
     return {};
   };
 
-  for (auto &feature : j["features"]) {
-    auto date_str = get_prop(feature["properties"], date_field_name);
-    auto date = generate_date_from_str(date_str.c_str());
-
-    auto &geom = feature["geometry"];
-    std::string gtype = geom["type"].get<std::string>();
+  DateParser date_parser(options.date_format);
+  auto read_feature = [&](const GeoJsonFeature &feature) {
+    auto date = date_parser.parse(get_date(feature));
 
-    auto read_line = [&](const nlohmann::json &coords) {
-      auto sl = std::make_unique<Shoreline>();
-      sl->shoreline_vertices_.reserve(coords.size());
-      for (auto &c : coords) {
-        sl->shoreline_vertices_.emplace_back(c[0].get<double>(),
-                                             c[1].get<double>());
-      }
-      sl->shoreline_id_ = shoreline_id;
-      sl->date_ = date;
-      return sl;
-    };
-
-    if (gtype == "LineString") {
-      shorelines.push_back(read_line(geom["coordinates"]));
-      ++shoreline_id;
-    } else if (gtype == "MultiLineString") {
-      for (auto &line : geom["coordinates"]) {
-        shorelines.push_back(read_line(line));
+    const auto &gtype = feature.geometry_type;
+    if (gtype == "LineString" || gtype == "MultiLineString") {
+      for (size_t k = 0; k < feature.num_parts(); ++k) {
+        const auto line = feature.part(k);
+        auto sl = std::make_unique<Shoreline>();
+        sl->shoreline_vertices_.assign(line.begin(), line.end());
+        sl->shoreline_id_ = shoreline_id;
+        sl->date_ = date;
+        sl->compute_envelopes();
+        shorelines.push_back(std::move(sl));
       }
-      ++shoreline_id;
     } else {
       std::cout << "Unsupported geometry type: " << gtype << "\n";
-      ++shoreline_id;
     }
-  }
+    ++shoreline_id;
+  };
+  GeoJsonCrs crs;
+  read_geojson_features(path, read_feature, &crs);
+  if (prj) *prj = crs.projection(path);
   return shorelines;
 }
 
 // ---- Shapefile reader ----
 
-// GCOVR_EXCL_START
-static std::vector<std::unique_ptr<Shoreline>> load_shorelines_shapelib(
+static std::vector<std::unique_ptr<Shoreline>> load_shorelines_shapefile(
     const std::filesystem::path &path, const char *date_field_name) {
-  const std::string base_path = (path.parent_path() / path.stem()).string();
-
-  SHPHandle hSHP = SHPOpen(base_path.c_str(), "rb");
-  if (!hSHP) OPENDSAS_THROW("Cannot open shapefile: " + path.string());
-  DBFHandle hDBF = DBFOpen(base_path.c_str(), "rb");
-  if (!hDBF) {
-    SHPClose(hSHP);
-    OPENDSAS_THROW("Cannot open DBF: " + path.string());
-  }
-
-  int date_idx = DBFGetFieldIndex(hDBF, date_field_name);
+  ShapefileReader shapefile(path);
+  const int date_idx = shapefile.field_index(date_field_name);
   if (date_idx < 0) {
-    SHPClose(hSHP);
-    DBFClose(hDBF);
     OPENDSAS_THROW("Date field '" + std::string(date_field_name) +
                    "' not found in shoreline shapefile");
   }
 
-  int n_entities = 0;
-  SHPGetInfo(hSHP, &n_entities, nullptr, nullptr, nullptr);
+  // one parser, with its cache, per thread
+  std::vector<DateParser> date_parsers(omp_get_max_threads(),
+                                       DateParser(options.date_format));
+  return read_records<std::unique_ptr<Shoreline>>(
+      shapefile, [&](size_t i, const ShapeRecord &record, auto &out) {
+        auto date = date_parsers[omp_get_thread_num()].parse(
+            shapefile.string_attribute(i, date_idx));
 
-  std::vector<std::unique_ptr<Shoreline>> shorelines;
-  for (int i = 0; i < n_entities; ++i) {
-    const char *date_str = DBFReadStringAttribute(hDBF, i, date_idx);
-    auto date = generate_date_from_str(date_str);
-
-    SHPObject *obj = SHPReadObject(hSHP, i);
-    if (!obj) continue;
-
-    if (obj->nSHPType == SHPT_ARC || obj->nSHPType == SHPT_ARCZ) {
-      for (int p = 0; p < obj->nParts; ++p) {
-        int start = obj->panPartStart[p];
-        int end =
-            (p + 1 < obj->nParts) ? obj->panPartStart[p + 1] : obj->nVertices;
-        auto sl = std::make_unique<Shoreline>();
-        sl->shoreline_vertices_.reserve(static_cast<size_t>(end - start));
-        for (int k = start; k < end; ++k) {
-          sl->shoreline_vertices_.emplace_back(obj->padfX[k], obj->padfY[k]);
+        if (record.shape_type != SHPT_ARC && record.shape_type != SHPT_ARCZ) {
+          return;
         }
-        sl->shoreline_id_ = i;
-        sl->date_ = date;
-        shorelines.push_back(std::move(sl));
-      }
-    }
-    SHPDestroyObject(obj);
-  }
-
-  SHPClose(hSHP);
-  DBFClose(hDBF);
-  return shorelines;
+        for (size_t p = 0; p < record.num_parts(); ++p) {
+          const auto line = record.part(p);
+          auto sl = std::make_unique<Shoreline>();
+          sl->shoreline_vertices_.assign(line.begin(), line.end());
+          sl->shoreline_id_ = static_cast<int>(i);
+          sl->date_ = date;
+          sl->compute_envelopes();
+          out.push_back(std::move(sl));
+        }
+      });
 }
-// GCOVR_EXCL_STOP
 
 // ---- Public dispatch ----
 
 std::vector<std::unique_ptr<Shoreline>> load_shorelines_shp(
     const std::filesystem::path &shoreline_shp_path,
-    const char *date_field_name) {
+    const char *date_field_name, std::string *prj) {
   auto ext = shoreline_shp_path.extension().string();
   if (ext == ".geojson" || ext == ".json") {
-    return load_shorelines_geojson(shoreline_shp_path, date_field_name);
+    return load_shorelines_geojson(shoreline_shp_path, date_field_name, prj);
   }
-  return load_shorelines_shapelib(shoreline_shp_path,
-                                  date_field_name);  // GCOVR_EXCL_LINE
+  if (prj) *prj = get_shp_proj(shoreline_shp_path.string().c_str());
+  return load_shorelines_shapefile(shoreline_shp_path, date_field_name);
 }
 
 }  // namespace dsas
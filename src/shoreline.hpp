@@ -1,6 +1,12 @@
 #ifndef SRC_SHORELINE_HPP_
 #define SRC_SHORELINE_HPP_
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include "geometry.hpp"
 
@@ -8,17 +14,38 @@ namespace dsas {
 
 extern double mean_shore_segment;  // mean length of shoreline segment
 struct Shoreline : public MultiLine<Point> {
+  // segments per entry of chunk_envelopes_
+  static constexpr size_t chunk_segments = 32;
+
   std::vector<Point> shoreline_vertices_;  // shoreline vertices
   int shoreline_id_{};                     // shoreline id
   Date date_;
+  // boxes for pruning the brute-force search, from compute_envelopes: all
+  // vertices, and those of segments [32 c, 32 c + 32) for chunk c
+  Envelope envelope_;
+  std::vector<Envelope> chunk_envelopes_;
 
   Shoreline(std::vector<Point> shoreline_vertices, int shoreline_id, Date date)
       : shoreline_vertices_{std::move(shoreline_vertices)},
         shoreline_id_{shoreline_id},
-        date_{date} {};
+        date_{date} {
+    compute_envelopes();
+  };
 
   Shoreline() = default;
 
+  // (re)computes the envelopes; needed after filling shoreline_vertices_
+  void compute_envelopes();
+
+  [[nodiscard]] size_t num_segments() const {
+    return shoreline_vertices_.empty() ? 0 : shoreline_vertices_.size() - 1;
+  }
+  // whether the chunk envelopes match the vertices they were computed from
+  [[nodiscard]] bool has_envelopes() const {
+    return chunk_envelopes_.size() ==
+           (num_segments() + chunk_segments - 1) / chunk_segments;
+  }
+
   [[nodiscard]] size_t size() const override {
     return shoreline_vertices_.size();
   }
@@ -27,15 +54,84 @@ struct Shoreline : public MultiLine<Point> {
   }
 };
 
-struct ShoreSeg {
-  Point start;
-  Point end;
-  Shoreline *shoreline = nullptr;  // shoreline object that this seg belong to
+// Compact reference to the segment [vertex, vertex + 1] of a shoreline,
+// resolved against the shoreline vertex arrays by the index that holds it.
+struct SegRef {
+  std::uint32_t shoreline;  // position of the shoreline in the indexed set
+  std::uint32_t vertex;     // index of the segment's first vertex
 };
+
+// The shorelines behind a spatial index: resolves SegRef to vertices and
+// numbers the segments densely across the set. The shorelines must outlive
+// the index.
+struct IndexedShorelines {
+  std::vector<const Shoreline *> shorelines;  // SegRef::shoreline -> object
+  std::vector<std::uint32_t> first_segment_id;  // per indexed shoreline
+
+  // fills the tables; throws if the references do not fit in 32 bits
+  void assign(const std::vector<std::unique_ptr<Shoreline>> &all);
+
+  [[nodiscard]] const Shoreline &shoreline(SegRef seg) const {
+    return *shorelines[seg.shoreline];
+  }
+  [[nodiscard]] const Point &start(SegRef seg) const {
+    return shorelines[seg.shoreline]->shoreline_vertices_[seg.vertex];
+  }
+  [[nodiscard]] const Point &end(SegRef seg) const {
+    return shorelines[seg.shoreline]->shoreline_vertices_[seg.vertex + 1];
+  }
+
+  // dense id of a segment, unique across the indexed shorelines
+  [[nodiscard]] std::uint32_t segment_id(SegRef seg) const {
+    return first_segment_id[seg.shoreline] + seg.vertex;
+  }
+  [[nodiscard]] size_t num_segment_ids() const {
+    return first_segment_id.empty()
+               ? 0
+               : first_segment_id.back() + shorelines.back()->size();
+  }
+};
+
+// Parses date strings in one strptime format, e.g. "%Y/%m/%d". The format
+// is compiled once: formats made only of %Y, %m, %d and separator
+// characters are read by hand, others (and strings the hand-written path
+// rejects) go through strptime, whose results are cached per distinct
+// string as a survey repeats its date over many records. Not thread-safe:
+// give each thread its own parser.
+class DateParser {
+ public:
+  explicit DateParser(std::string format);
+
+  [[nodiscard]] const std::string &format() const { return format_; }
+
+  // the date in text; throws DSASError if text does not match the format
+  Date parse(std::string_view text);
+
+ private:
+  enum class Field : char { Year, Month, Day, Literal };
+  struct Token {
+    Field field;
+    char literal;  // for Field::Literal
+  };
+  static constexpr size_t max_cached = 1 << 16;
+
+  [[nodiscard]] std::optional<Date> parse_numeric(std::string_view text) const;
+  [[nodiscard]] Date parse_strptime(const std::string &text) const;
+
+  std::string format_;
+  std::vector<Token> tokens_;  // empty if the format has no fast path
+  std::unordered_map<std::string, Date> cache_;
+  std::string last_text_;  // last string strptime parsed, checked first
+  Date last_date_;
+};
+
+// Parses one date in options.date_format; loaders keep a DateParser instead.
 Date generate_date_from_str(const char *date_str);
+// Loads the shorelines of a shapefile or GeoJSON file. If prj is given, the
+// file's projection (see get_shp_proj) is read into it in the same pass.
 std::vector<std::unique_ptr<Shoreline>> load_shorelines_shp(
     const std::filesystem::path &shoreline_shp_path,
-    const char *date_field_name);
+    const char *date_field_name, std::string *prj = nullptr);
 
 }  // namespace dsas
 #endif
\ No newline at end of file
@@ -2,17 +2,24 @@
 
 #include <shapefil.h>
 
+#include <algorithm>
+#include <bit>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <memory>
-#include <nlohmann/json.hpp>
+#include <tuple>
 #include <utility>
 
 #include "exception.hpp"
+#include "geojson.hpp"
 #include "grid.hpp"
 #include "intersect.hpp"
 #include "options.hpp"
+#include "rtree.hpp"
+#include "segment_batch.hpp"
+#include "shapefile.hpp"
 #include "utility.hpp"
 
 namespace dsas {
@@ -51,112 +58,247 @@ LineSegment TransectLine::create_transect(
   return {leftEdge, rightEdge};
 }
 
-std::optional<IntersectPoint> TransectLine::intersection(
-    const Shoreline &shoreline) const {
-  std::vector<IntersectPoint> intersections;
-
-  // find out all the available intersection
-  for (size_t i = 0; i < shoreline.size() - 1; i++) {
-    if (is_intersect(shoreline[i], shoreline[i + 1])) {
-      auto ret = find_intersection(shoreline[i], shoreline[i + 1]);
-      auto point = Point((shoreline[i].x + shoreline[i + 1].x) / 2,
-                         (shoreline[i].y + shoreline[i + 1].y) / 2);
-      if (ret) {
-        point = ret.value();
-      }
-      auto distance = distance2ref(point);
-      IntersectPoint intersect_point{
-          point,        transect_id_,    shoreline.shoreline_id_,
-          baseline_id_, shoreline.date_, distance};
-      intersections.push_back(intersect_point);
-    }
+namespace {
+thread_local SegmentBatch segment_batch;
+thread_local BatchHits batch_hits;
+
+// Runs the batched kernel on the segments gathered so far, passes each
+// crossing to visit as (lane, point, distance to the reference point) and
+// empties the batch.
+template <typename Visit>
+void flush_batch(const TransectQuery &transect, SegmentBatch &batch,
+                 Visit &&visit) {
+  if (batch.empty()) return;
+  auto &hits = batch_hits;
+  intersect_batch(transect.constants, batch, hits);
+  for (auto mask = hits.mask; mask != 0; mask &= mask - 1) {
+    const auto k = static_cast<size_t>(std::countr_zero(mask));
+    visit(k, point_along(transect.left(), transect.right(), hits.t[k]),
+          std::abs(transect.offset_at(hits.t[k])));
   }
+  batch.clear();
+}
+}  // namespace
+
+namespace {
+// Whether a hit at distance a replaces the one kept at distance b.
+bool preferred(TransectQuery::IntersectionMode mode, double a, double b) {
+  return mode == TransectQuery::IntersectionMode::Farthest ? a > b : a < b;
+}
+}  // namespace
 
-  // if no intersection
-  if (intersections.empty()) {
-    return std::nullopt;
+std::optional<IntersectRow> TransectQuery::intersection(
+    const Shoreline &shoreline) const {
+  // find out all the available intersection, 64 segments at a time, keeping
+  // only the best one under the intersection mode
+  std::optional<IntersectRow> best;
+  auto &batch = segment_batch;
+  const auto date = shoreline.date_.packed();
+  const auto day = static_cast<std::int32_t>(shoreline.date_.julian_day());
+  auto keep_best = [&](size_t, const Point &point, double distance) {
+    if (best && !preferred(mode, distance, best->distance)) return;
+    best = IntersectRow{point.x, point.y, transect_id, shoreline.shoreline_id_,
+                        baseline_id, date, day, distance};
+  };
+  auto test_segments = [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+      batch.push(shoreline[i], shoreline[i + 1]);
+      if (batch.full()) flush_batch(*this, batch, keep_best);
+    }
+  };
+
+  // whole shorelines, then runs of chunk_segments segments, whose envelope
+  // misses the transect's are skipped with one box test
+  const Envelope box{constants.min_x, constants.min_y, constants.max_x,
+                     constants.max_y};
+  const size_t n = shoreline.num_segments();
+  if (!shoreline.has_envelopes()) {
+    test_segments(0, n);
+  } else if (shoreline.envelope_.intersects(box)) {
+    for (size_t c = 0; c < shoreline.chunk_envelopes_.size(); c++) {
+      if (!shoreline.chunk_envelopes_[c].intersects(box)) continue;
+      const size_t first = c * Shoreline::chunk_segments;
+      test_segments(first, std::min(n, first + Shoreline::chunk_segments));
+    }
   }
+  flush_batch(*this, batch, keep_best);
+  return best;
+}
 
-  // if only one intersection
-  if (intersections.size() == 1) {
-    return intersections[0];
+void ShorelineSlots::keep(dsas::Options::IntersectionMode mode,
+                          const IndexHit &hit) {
+  auto &k = slot[hit.shoreline];
+  if (k < 0) {
+    k = static_cast<std::int32_t>(hits.size());
+    hits.push_back(hit);
+  } else if (preferred(mode, hit.distance, hits[k].distance)) {
+    hits[k] = hit;
   }
+}
 
-  // if more than two intersections, pick one base on the intersection mode
-  std::sort(intersections.begin(), intersections.end(),
-            [](const IntersectPoint &a, const IntersectPoint &b) {
-              return a.distance_to_ref_ < b.distance_to_ref_;
-            });
-
-  if (mode_ == IntersectionMode::Farthest) {
-    // farthest mode return farthest distance
-    return intersections[intersections.size() - 1];
-  } else {
-    // close mode return smallest dis
-    return intersections[0];
+namespace {
+// Tests the transect against the candidate segments that for_each_candidate
+// passes to its callback and keeps one hit per shoreline, following the
+// intersection mode, appending them to out in shoreline order. Shared by the
+// grid and R-tree queries.
+template <typename Index, typename ForEachCandidate>
+void collect_intersections(const TransectQuery &transect, const Index &index,
+                           IntersectTable &out, ShorelineSlots &slots,
+                           ForEachCandidate &&for_each_candidate) {
+  slots.next_query(index.shorelines.size());
+
+  // find out all the available intersection, gathering the candidates into
+  // batches for the kernel
+  auto &batch = segment_batch;
+  SegRef refs[SegmentBatch::capacity];
+  auto add_hit = [&](size_t k, const Point &point, double distance) {
+    slots.keep(transect.mode,
+               IndexHit{point, distance, index.shoreline(refs[k]).shoreline_id_,
+                        refs[k].shoreline});
+  };
+  for_each_candidate([&](SegRef seg) {
+    refs[batch.size] = seg;
+    batch.push(index.start(seg), index.end(seg));
+    if (batch.full()) flush_batch(transect, batch, add_hit);
+  });
+  flush_batch(transect, batch, add_hit);
+
+  // one hit per shoreline is left; emit them by shoreline id
+  auto &hits = slots.hits;
+  std::sort(hits.begin(), hits.end(), [](const auto &a, const auto &b) {
+    return a.shoreline_id < b.shoreline_id ||
+           (a.shoreline_id == b.shoreline_id && a.shoreline < b.shoreline);
+  });
+  for (const auto &hit : hits) {
+    const auto &date = index.shorelines[hit.shoreline]->date_;
+    out.push_back(IntersectRow{
+        hit.point.x, hit.point.y, transect.transect_id, hit.shoreline_id,
+        transect.baseline_id, date.packed(),
+        static_cast<std::int32_t>(date.julian_day()), hit.distance});
   }
+  slots.finish_query();
+}
+}  // namespace
+
+void TransectQuery::intersection(const Grids &grids, IntersectTable &out,
+                                 IndexQueryScratch &scratch) const {
+  if (grids.empty()) return;
+
+  auto &mailbox = scratch.mailbox;
+  mailbox.next_query(grids.num_segment_ids());
+  collect_intersections(*this, grids, out, scratch.slots, [&](auto &&test) {
+    auto search_cell = [&](size_t grid_i, size_t grid_j) {
+      for (const auto seg : grids.cell(grid_i, grid_j)) {
+        if (mailbox.first_visit(grids.segment_id(seg))) test(seg);
+      }
+    };
+    // use the cells stored by build_transect_index for this very grid if
+    // any, otherwise walk the grid
+    if (!cells.empty() && *cells_bound == grids.bound) {
+      for (auto [grid_i, grid_j] : cells) search_cell(grid_i, grid_j);
+    } else {
+      grids.traverse(left(), right(), search_cell);
+    }
+  });
 }
 
-std::vector<std::unique_ptr<IntersectPoint>> TransectLine::intersection(
-    const Grids &grids) const {
-  if (grid_index.empty()) return {};
+void TransectQuery::intersection(const RTree &rtree, IntersectTable &out,
+                                 IndexQueryScratch &scratch) const {
+  if (rtree.empty()) return;
 
-  std::vector<std::unique_ptr<IntersectPoint>> intersections;
+  // each segment sits in exactly one leaf, so no mailbox is needed
+  collect_intersections(*this, rtree, out, scratch.slots, [&](auto &&test) {
+    rtree.query(left(), right(), test);
+  });
+}
 
-  // find out all the available intersection
-  for (auto [grid_i, grid_j] : grid_index) {
-    const size_t grid_index = grid_i * Grid::grid_ny + grid_j;
-    if (grids.find(grid_index) == grids.end()) {
-      continue;
-    }
-    const auto &grid = grids.at(grid_index);
-    for (const auto &shore_seg : grid->shoreline_segs) {
-      if (is_intersect(shore_seg.start, shore_seg.end)) {
-        auto ret = find_intersection(shore_seg.start, shore_seg.end);
-        auto point = Point((shore_seg.start.x + shore_seg.end.x) / 2,
-                           (shore_seg.start.y + shore_seg.end.y) / 2);
-        if (ret) {
-          point = ret.value();
-        }
-        auto distance = distance2ref(point);
-        auto intersect_point = std::make_unique<IntersectPoint>(
-            point, transect_id_, shore_seg.shoreline->shoreline_id_,
-            baseline_id_, shore_seg.shoreline->date_, distance);
-        intersections.push_back(std::move(intersect_point));
-      }
-    }
+void TransectTable::push_back(const TransectLine &line) {
+  if (empty()) {
+    mode = line.mode_;
+  } else if (line.mode_ != mode) {
+    OPENDSAS_THROW("Transects of one table must share the intersection mode");
   }
+  left_x.push_back(line.leftEdge_.x);
+  left_y.push_back(line.leftEdge_.y);
+  right_x.push_back(line.rightEdge_.x);
+  right_y.push_back(line.rightEdge_.y);
+  ref_x.push_back(line.transect_ref_point_.x);
+  ref_y.push_back(line.transect_ref_point_.y);
+  base_x.push_back(line.transect_base_point_.x);
+  base_y.push_back(line.transect_base_point_.y);
+  transect_id.push_back(line.transect_id_);
+  baseline_id.push_back(line.baseline_id_);
+  change_rate.push_back(line.change_rate);
+  intersects.emplace_back();
+  cell_first.clear();
+  cells.clear();
+}
 
-  // if more than two intersections, pick one base on the intersection mode
-  std::sort(intersections.begin(), intersections.end(),
-            [&](const auto &a, const auto &b) {
-              if (a->shoreline_id_ == b->shoreline_id_) {
-                return mode_ == IntersectionMode::Farthest
-                           ? a->distance_to_ref_ > b->distance_to_ref_
-                           : a->distance_to_ref_ < b->distance_to_ref_;
-              }
-              return a->shoreline_id_ < b->shoreline_id_;
-            });
-
-  intersections.erase(
-      std::unique(
-          intersections.begin(), intersections.end(),
-          [](auto &a, auto &b) {
-            return a->shoreline_id_ ==
-                   b->shoreline_id_;  // consider "same" if first is equal
-          }),
-      intersections.end());
-  return intersections;
+void TransectTable::append(const TransectTable &other) {
+  if (other.empty()) return;
+  if (empty()) {
+    mode = other.mode;
+  } else if (other.mode != mode) {
+    OPENDSAS_THROW("Transects of one table must share the intersection mode");
+  }
+  auto extend = [](auto &to, const auto &from) {
+    to.insert(to.end(), from.begin(), from.end());
+  };
+  extend(left_x, other.left_x);
+  extend(left_y, other.left_y);
+  extend(right_x, other.right_x);
+  extend(right_y, other.right_y);
+  extend(ref_x, other.ref_x);
+  extend(ref_y, other.ref_y);
+  extend(base_x, other.base_x);
+  extend(base_y, other.base_y);
+  extend(transect_id, other.transect_id);
+  extend(baseline_id, other.baseline_id);
+  extend(change_rate, other.change_rate);
+  extend(intersects, other.intersects);
+  cell_first.clear();
+  cells.clear();
 }
 
-std::vector<std::unique_ptr<TransectLine>> create_transects_from_baseline(
-    Baseline &baseline) {
-  std::vector<std::unique_ptr<TransectLine>> transect_lines;
+void TransectTable::reserve(size_t n) {
+  left_x.reserve(n);
+  left_y.reserve(n);
+  right_x.reserve(n);
+  right_y.reserve(n);
+  ref_x.reserve(n);
+  ref_y.reserve(n);
+  base_x.reserve(n);
+  base_y.reserve(n);
+  transect_id.reserve(n);
+  baseline_id.reserve(n);
+  change_rate.reserve(n);
+  intersects.reserve(n);
+}
+
+void TransectTable::clear() {
+  left_x.clear();
+  left_y.clear();
+  right_x.clear();
+  right_y.clear();
+  ref_x.clear();
+  ref_y.clear();
+  base_x.clear();
+  base_y.clear();
+  transect_id.clear();
+  baseline_id.clear();
+  change_rate.clear();
+  intersects.clear();
+  cell_first.clear();
+  cells.clear();
+}
+
+void create_transects_from_baseline(Baseline &baseline, TransectTable &out) {
   // smoothing the transects
   auto smooth_factor = options.smooth_factor;
   auto transect_length = options.transect_length;
   auto mode = options.intersection_mode;
   auto orient = options.transect_orient;
+  out.reserve(out.size() + baseline.normal_vectors_.size());
   int transect_id{0};
   for (size_t i = 0; i < baseline.normal_vectors_.size(); i++) {
     size_t start = i;
@@ -175,155 +317,157 @@ std::vector<std::unique_ptr<TransectLine>> create_transects_from_baseline(
       smoothed_normal_vector.first = baseline.normal_vectors_.at(i).first;
       smoothed_normal_vector.second = baseline.normal_vectors_.at(i).second;
     }
-    transect_lines.emplace_back(std::make_unique<TransectLine>(
-        baseline.transects_base_points_.at(i), transect_length,
-        smoothed_normal_vector, transect_id++, baseline.baseline_id_, mode,
-        orient));
-    baseline.baseline_vertices_.push_back(
-        transect_lines.at(transect_lines.size() - 1)->transect_ref_point_);
+    const TransectLine line(baseline.transects_base_points_.at(i),
+                            transect_length, smoothed_normal_vector,
+                            transect_id++, baseline.baseline_id_, mode, orient);
+    out.push_back(line);
+    baseline.baseline_vertices_.push_back(line.transect_ref_point_);
   }
-  return transect_lines;
 }
 
-// ---- GeoJSON reader ----
-
-static std::vector<std::unique_ptr<TransectLine>> load_transects_geojson(
-    const std::filesystem::path &path) {
-  std::ifstream f(path);
-  if (!f) OPENDSAS_THROW("Cannot open: " + path.string());
-  auto j = nlohmann::json::parse(f);
-
-  if (!j.contains("features") || j["features"].empty()) {
-    OPENDSAS_THROW("No features found in transect file: " + path.string());
-  }
-
-  // Validate required fields in first feature
-  const auto &first_props = j["features"][0]["properties"];
-  if (!first_props.contains("TransectId")) {
-    OPENDSAS_THROW("Need to specify TransectId!");
-  }
-  if (!first_props.contains("BaselineId")) {
-    OPENDSAS_THROW("Need to specify BaselineId!");
-  }
-
-  std::vector<std::unique_ptr<TransectLine>> transects;
-  for (auto &feature : j["features"]) {
-    auto &props = feature["properties"];
-    int transect_id = props["TransectId"].get<int>();
-    int baseline_id = props["BaselineId"].get<int>();
-
-    auto &coords = feature["geometry"]["coordinates"];
-    Point left(coords.front()[0].get<double>(),
-               coords.front()[1].get<double>());
-    Point right(coords.back()[0].get<double>(), coords.back()[1].get<double>());
-
-    transects.push_back(std::make_unique<TransectLine>(
-        left, right, transect_id, baseline_id, options.intersection_mode,
-        options.transect_orient));
-  }
+TransectTable create_transects_from_baseline(Baseline &baseline) {
+  TransectTable transects;
+  create_transects_from_baseline(baseline, transects);
+  return transects;
+}
 
-  // Derive length and spacing from the loaded transects
+// Sets the transect length and spacing options from the loaded transects.
+static void derive_transect_options(const TransectTable &transects) {
   if (transects.size() >= 1) {
     options.transect_length =
-        transects[0]->leftEdge_.distance_to_point(transects[0]->rightEdge_);
+        transects[0].left_edge().distance_to_point(transects[0].right_edge());
   }
   if (transects.size() >= 2) {
     options.transect_spacing =
-        transects[0]->leftEdge_.distance_to_point(transects[1]->leftEdge_);
+        transects[0].left_edge().distance_to_point(transects[1].left_edge());
   }
-
-  return transects;
 }
 
-// ---- Shapefile reader ----
+// ---- GeoJSON reader ----
 
-// GCOVR_EXCL_START
-static std::vector<std::unique_ptr<TransectLine>> load_transects_shapelib(
+static TransectTable load_transects_geojson(
     const std::filesystem::path &path) {
-  const std::string base_path = (path.parent_path() / path.stem()).string();
-
-  SHPHandle hSHP = SHPOpen(base_path.c_str(), "rb");
-  if (!hSHP) OPENDSAS_THROW("Cannot open shapefile: " + path.string());
-  DBFHandle hDBF = DBFOpen(base_path.c_str(), "rb");
-  if (!hDBF) {
-    SHPClose(hSHP);
-    OPENDSAS_THROW("Cannot open DBF: " + path.string());
-  }
-
-  int tid_idx = DBFGetFieldIndex(hDBF, "TransectId");
-  if (tid_idx < 0) {
-    SHPClose(hSHP);
-    DBFClose(hDBF);
-    OPENDSAS_THROW("Need to specify TransectId!");
-  }
-  int bid_idx = DBFGetFieldIndex(hDBF, "BaselineId");
-  if (bid_idx < 0) {
-    SHPClose(hSHP);
-    DBFClose(hDBF);
-    OPENDSAS_THROW("Need to specify BaselineId!");
-  }
-
-  int n_entities = 0;
-  SHPGetInfo(hSHP, &n_entities, nullptr, nullptr, nullptr);
-
-  std::vector<std::unique_ptr<TransectLine>> transects;
-  for (int i = 0; i < n_entities; ++i) {
-    int transect_id = DBFReadIntegerAttribute(hDBF, i, tid_idx);
-    int baseline_id = DBFReadIntegerAttribute(hDBF, i, bid_idx);
-
-    SHPObject *obj = SHPReadObject(hSHP, i);
-    if (!obj || obj->nVertices < 2) {
-      if (obj) SHPDestroyObject(obj);
-      continue;
+  TransectTable transects;
+  read_geojson_features(path, [&](const GeoJsonFeature &feature) {
+    const auto *transect_id = feature.property("TransectId");
+    if (!transect_id) OPENDSAS_THROW("Need to specify TransectId!");
+    const auto *baseline_id = feature.property("BaselineId");
+    if (!baseline_id) OPENDSAS_THROW("Need to specify BaselineId!");
+    if (feature.points.empty()) {
+      OPENDSAS_THROW("Transect without coordinates in: " + path.string());
     }
-    Point left(obj->padfX[0], obj->padfY[0]);
-    Point right(obj->padfX[obj->nVertices - 1], obj->padfY[obj->nVertices - 1]);
-    SHPDestroyObject(obj);
-
-    transects.push_back(std::make_unique<TransectLine>(
-        left, right, transect_id, baseline_id, options.intersection_mode,
+    transects.push_back(TransectLine(
+        feature.points.front(), feature.points.back(), transect_id->get<int>(),
+        baseline_id->get<int>(), options.intersection_mode,
         options.transect_orient));
+  });
+  if (transects.empty()) {
+    OPENDSAS_THROW("No features found in transect file: " + path.string());
   }
 
-  SHPClose(hSHP);
-  DBFClose(hDBF);
+  // Derive length and spacing from the loaded transects
+  derive_transect_options(transects);
 
-  if (transects.size() >= 1) {
-    options.transect_length =
-        transects[0]->leftEdge_.distance_to_point(transects[0]->rightEdge_);
-  }
-  if (transects.size() >= 2) {
-    options.transect_spacing =
-        transects[0]->leftEdge_.distance_to_point(transects[1]->leftEdge_);
-  }
+  return transects;
+}
+
+// ---- Shapefile reader ----
+
+static TransectTable load_transects_shapefile(
+    const std::filesystem::path &path) {
+  ShapefileReader shapefile(path);
+  const int tid_idx = shapefile.field_index("TransectId");
+  if (tid_idx < 0) OPENDSAS_THROW("Need to specify TransectId!");
+  const int bid_idx = shapefile.field_index("BaselineId");
+  if (bid_idx < 0) OPENDSAS_THROW("Need to specify BaselineId!");
+
+  // each range of records is decoded straight into a table of its own
+  const auto ranges = read_record_ranges<TransectTable>(
+      shapefile, [&](size_t i, const ShapeRecord &record, auto &out) {
+        if (record.points.size() < 2) return;
+        out.push_back(TransectLine(
+            record.points.front(), record.points.back(),
+            shapefile.integer_attribute(i, tid_idx),
+            shapefile.integer_attribute(i, bid_idx), options.intersection_mode,
+            options.transect_orient));
+      });
+  size_t total = 0;
+  for (const auto &range : ranges) total += range.size();
+  TransectTable transects;
+  transects.reserve(total);
+  for (const auto &range : ranges) transects.append(range);
+
+  derive_transect_options(transects);
 
   return transects;
 }
-// GCOVR_EXCL_STOP
 
 // ---- Public dispatch ----
 
-std::vector<std::unique_ptr<TransectLine>> load_transects_from_shp(
+TransectTable load_transects_from_shp(
     const std::filesystem::path &transect_shp_path) {
   auto ext = transect_shp_path.extension().string();
   if (ext == ".geojson" || ext == ".json") {
     return load_transects_geojson(transect_shp_path);
   }
-  return load_transects_shapelib(transect_shp_path);  // GCOVR_EXCL_LINE
+  return load_transects_shapefile(transect_shp_path);
 }
 
-void save_transect(const std::vector<std::unique_ptr<TransectLine>> &transects,
-                   const std::string &prj, bool save_as_point) {
-  std::vector<TransectLine *> tmp_save;
-  tmp_save.reserve(transects.size());
-  std::transform(transects.begin(), transects.end(),
-                 std::back_inserter(tmp_save),
-                 [](const auto &up) { return up.get(); });
-  if (save_as_point) {
-    save_points(tmp_save, prj, dsas::options.transect_path);
-  } else {
-    save_lines(tmp_save, prj, dsas::options.transect_path);
+void save_transect(const TransectTable &transects, const std::string &prj,
+                   bool save_as_point) {
+  if (transects.empty()) {
+    OPENDSAS_THROW(save_as_point ? "No point to save!" : "No line to save!");
+  }
+  if (!looks_like_proj(prj)) {
+    OPENDSAS_THROW("Projection setting failed");
+  }
+
+  // GCOVR_EXCL_START
+  const std::filesystem::path output_path = options.transect_path;
+  auto base = output_path;
+  base.replace_extension("");
+  const std::string base_str = base.string();
+
+  SHPHandle hSHP =
+      SHPCreate(base_str.c_str(), save_as_point ? SHPT_POINT : SHPT_ARC);
+  if (!hSHP) {
+    OPENDSAS_THROW("Failed to create shapefile: " + output_path.string());
+  }
+  DBFHandle hDBF = DBFCreate(base_str.c_str());
+  if (!hDBF) {
+    SHPClose(hSHP);
+    OPENDSAS_THROW("Failed to create DBF: " + output_path.string());
   }
+
+  dbf_add_field(hDBF, "TransectId", FieldType::Integer);
+  dbf_add_field(hDBF, "BaselineId", FieldType::Integer);
+  dbf_add_field(hDBF, "ChangeRate", FieldType::Real);
+
+  for (size_t i = 0; i < transects.size(); ++i) {
+    SHPObject *obj;
+    if (save_as_point) {
+      double x = transects.base_x[i], y = transects.base_y[i];
+      obj = SHPCreateSimpleObject(SHPT_POINT, 1, &x, &y, nullptr);
+    } else {
+      // left edge, reference point and right edge, as TransectLine's vertices
+      double xs[]{transects.left_x[i], transects.ref_x[i],
+                  transects.right_x[i]};
+      double ys[]{transects.left_y[i], transects.ref_y[i],
+                  transects.right_y[i]};
+      obj = SHPCreateSimpleObject(SHPT_ARC, 3, xs, ys, nullptr);
+    }
+    SHPWriteObject(hSHP, -1, obj);
+    SHPDestroyObject(obj);
+    write_dbf_record(hDBF, static_cast<int>(i),
+                     std::tuple{transects.transect_id[i],
+                                transects.baseline_id[i],
+                                transects.change_rate[i]});
+  }
+
+  SHPClose(hSHP);
+  DBFClose(hDBF);
+  write_prj(output_path, prj);
+  // GCOVR_EXCL_STOP
 }
 
 }  // namespace dsas
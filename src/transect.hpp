@@ -1,27 +1,141 @@
 #ifndef SRC_TRANSECT_HPP_
 #define SRC_TRANSECT_HPP_
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <optional>
+#include <span>
 #include <stdexcept>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "baseline.hpp"
 #include "exception.hpp"
 #include "geometry.hpp"
+#include "grid.hpp"
 #include "intersect.hpp"
+#include "segment_batch.hpp"
 #include "shoreline.hpp"
 
 namespace dsas {
-struct Grid;  // forward declaration
+struct RTree;  // forward declaration
 
 using TransectFields = std::tuple<int, int, double>;
 
+// Stamps each segment id with the last query (epoch) that tested it, so a
+// segment overlapping several cells is tested once per transect.
+struct SegmentMailbox {
+  std::vector<std::uint32_t> stamps;
+  std::uint32_t epoch{0};
+
+  // starts a new query over segment ids in [0, n)
+  void next_query(size_t n) {
+    if (stamps.size() < n) stamps.resize(n, 0);
+    if (++epoch == 0) {  // wrapped around: forget every old stamp
+      std::fill(stamps.begin(), stamps.end(), 0);
+      epoch = 1;
+    }
+  }
+  bool first_visit(std::uint32_t id) {
+    if (stamps[id] == epoch) return false;
+    stamps[id] = epoch;
+    return true;
+  }
+};
+
+// A hit found by an index query, the best one of its shoreline so far.
+struct IndexHit {
+  Point point;
+  double distance;
+  int shoreline_id;
+  std::uint32_t shoreline;  // SegRef::shoreline of the hit segment
+};
+
+// The best hit per shoreline of the running query: slot[shoreline] is the
+// position of the shoreline's hit in hits, or -1. Only the slots of hit
+// shorelines are touched, and reset when the query is done.
+struct ShorelineSlots {
+  std::vector<std::int32_t> slot;
+  std::vector<IndexHit> hits;
+
+  void next_query(size_t num_shorelines) {
+    if (slot.size() < num_shorelines) slot.resize(num_shorelines, -1);
+  }
+  void keep(dsas::Options::IntersectionMode mode, const IndexHit &hit);
+  void finish_query() {
+    for (const auto &hit : hits) slot[hit.shoreline] = -1;
+    hits.clear();
+  }
+};
+
+// Buffers of the index queries that grow with the index. A parallel pass
+// keeps one per thread for its length.
+struct IndexQueryScratch {
+  SegmentMailbox mailbox;
+  ShorelineSlots slots;
+};
+
+// What the intersection queries need of one transect, made on the fly from
+// a TransectLine or a row of a TransectTable.
+struct TransectQuery {
+  using IntersectionMode = dsas::Options::IntersectionMode;
+  TransectConstants constants;  // for intersect_segment, from the edges
+  double length;                // |right - left|
+  double ref_t;                 // position of the reference point
+  int transect_id;
+  int baseline_id;
+  IntersectionMode mode;
+  // cells from build_transect_index and the grid they are of, if any
+  std::span<const std::pair<int, int>> cells;
+  const GridBound *cells_bound{nullptr};
+
+  // the reference point lies on the transect
+  TransectQuery(const Point &left, const Point &right, const Point &ref,
+                int transect_id, int baseline_id, IntersectionMode mode)
+      : constants(left, right),
+        length(std::hypot(constants.dx, constants.dy)),
+        ref_t(((ref.x - left.x) * constants.dx +
+               (ref.y - left.y) * constants.dy) *
+              constants.inv_len2),
+        transect_id(transect_id),
+        baseline_id(baseline_id),
+        mode(mode) {}
+
+  [[nodiscard]] Point left() const { return {constants.ax, constants.ay}; }
+  [[nodiscard]] Point right() const { return {constants.bx, constants.by}; }
+
+  // Signed distance from the reference point to the point at position t.
+  [[nodiscard]] double offset_at(double t) const {
+    return (t - ref_t) * length;
+  }
+
+  // Best intersection with the shoreline under the intersection mode.
+  [[nodiscard]] std::optional<IntersectRow> intersection(
+      const Shoreline &shoreline) const;
+
+  // Append one row per shoreline the transect crosses to out, picked by the
+  // intersection mode, in shoreline id order. The grid query reads the
+  // stored cells if they are of this grid and walks it otherwise.
+  void intersection(const Grids &grids, IntersectTable &out,
+                    IndexQueryScratch &scratch) const;
+  void intersection(const Grids &grids, IntersectTable &out) const {
+    IndexQueryScratch scratch;
+    intersection(grids, out, scratch);
+  }
+  void intersection(const RTree &rtree, IntersectTable &out,
+                    IndexQueryScratch &scratch) const;
+  void intersection(const RTree &rtree, IntersectTable &out) const {
+    IndexQueryScratch scratch;
+    intersection(rtree, out, scratch);
+  }
+};
+
 struct TransectLine : public LineSegment,
                       MultiLine<Point>,
                       PointAttribute<double>,
                       ShpSavable<TransectFields> {
   using IntersectionMode = dsas::Options::IntersectionMode;
   using TransectOrientation = dsas::Options::TransectOrientation;
-  using Grids = std::unordered_map<size_t, std::unique_ptr<Grid>>;
   Point transect_base_point_;  // point to generate the shapefile
   Point transect_ref_point_;   // point to calculate the erosion
   int transect_id_;
@@ -29,9 +143,6 @@ struct TransectLine : public LineSegment,
   double change_rate{};  // change rate for all the intersections
   IntersectionMode mode_;
   TransectOrientation orient_;
-  std::vector<IntersectPoint *>
-      intersects;  // pointers to intersects in this transects
-  std::vector<std::pair<int, int>> grid_index;
 
   TransectLine(Point &transect_base, double transect_length,
                std::pair<double, double> baseline_normal_vector,
@@ -83,11 +194,23 @@ struct TransectLine : public LineSegment,
       Point &transect_base, std::pair<double, double> baseline_normal_vector,
       double transect_length, TransectOrientation orient);
 
-  [[nodiscard]] std::optional<IntersectPoint> intersection(
-      const Shoreline &shoreline) const;
+  [[nodiscard]] TransectQuery query() const {
+    return {leftEdge_,    rightEdge_,    transect_ref_point_,
+            transect_id_, baseline_id_, mode_};
+  }
 
-  [[nodiscard]] std::vector<std::unique_ptr<IntersectPoint>> intersection(
-      const Grids &grids) const;
+  [[nodiscard]] std::optional<IntersectRow> intersection(
+      const Shoreline &shoreline) const {
+    return query().intersection(shoreline);
+  }
+
+  // see TransectQuery; a TransectLine has no stored cells
+  void intersection(const Grids &grids, IntersectTable &out) const {
+    query().intersection(grids, out);
+  }
+  void intersection(const RTree &rtree, IntersectTable &out) const {
+    query().intersection(rtree, out);
+  }
 
   double distance2ref(Point &point) const {
     return transect_ref_point_.distance_to_point(point);
@@ -122,14 +245,122 @@ struct TransectLine : public LineSegment,
   [[nodiscard]] double get_y() const override { return transect_base_point_.y; }
 };
 
-std::vector<std::unique_ptr<TransectLine>> create_transects_from_baseline(
-    Baseline &);
+struct TransectTable;
+
+// Row i of a TransectTable, read through accessors named after the fields
+// of TransectLine, with the same intersection queries.
+struct TransectView {
+  const TransectTable *table;
+  size_t i;
+
+  [[nodiscard]] Point left_edge() const;
+  [[nodiscard]] Point right_edge() const;
+  [[nodiscard]] Point ref_point() const;
+  [[nodiscard]] Point base_point() const;
+  [[nodiscard]] int transect_id() const;
+  [[nodiscard]] int baseline_id() const;
+  [[nodiscard]] double change_rate() const;
+  [[nodiscard]] IntersectRange intersects() const;
+  [[nodiscard]] std::span<const std::pair<int, int>> grid_cells() const;
+  [[nodiscard]] TransectQuery query() const;
+
+  [[nodiscard]] std::optional<IntersectRow> intersection(
+      const Shoreline &shoreline) const {
+    return query().intersection(shoreline);
+  }
+  void intersection(const Grids &grids, IntersectTable &out) const {
+    query().intersection(grids, out);
+  }
+  void intersection(const RTree &rtree, IntersectTable &out) const {
+    query().intersection(rtree, out);
+  }
+};
+
+// Transects in columnar form, one array per field, so a transect takes
+// about 100 bytes and no allocation of its own. This is what the pipeline
+// passes around; table[i] reads a row as a TransectView.
+struct TransectTable {
+  using IntersectionMode = dsas::Options::IntersectionMode;
+  std::vector<double> left_x, left_y, right_x, right_y;  // edges
+  std::vector<double> ref_x, ref_y;    // point the distances are taken from
+  std::vector<double> base_x, base_y;  // point written by save_as_point
+  std::vector<int> transect_id;
+  std::vector<int> baseline_id;
+  std::vector<double> change_rate;
+  std::vector<IntersectRange> intersects;  // rows in the IntersectTable
+  // cells from build_transect_index: those of transect i are
+  // cells[cell_first[i], cell_first[i + 1]); cell_first is empty until built
+  std::vector<size_t> cell_first;
+  std::vector<std::pair<int, int>> cells;
+  GridBound cells_bound;
+  IntersectionMode mode{IntersectionMode::Closest};  // of every transect
+
+  [[nodiscard]] size_t size() const { return left_x.size(); }
+  [[nodiscard]] bool empty() const { return left_x.empty(); }
+
+  [[nodiscard]] TransectView operator[](size_t i) const { return {this, i}; }
+
+  [[nodiscard]] TransectQuery query(size_t i) const {
+    TransectQuery query({left_x[i], left_y[i]}, {right_x[i], right_y[i]},
+                        {ref_x[i], ref_y[i]}, transect_id[i], baseline_id[i],
+                        mode);
+    if (!cell_first.empty()) {
+      query.cells = grid_cells(i);
+      query.cells_bound = &cells_bound;
+    }
+    return query;
+  }
+
+  [[nodiscard]] std::span<const std::pair<int, int>> grid_cells(
+      size_t i) const {
+    if (cell_first.empty()) return {};
+    return {cells.data() + cell_first[i], cell_first[i + 1] - cell_first[i]};
+  }
+
+  // appends the line's fields; the stored cells are dropped. The first line
+  // sets mode, and a later line with another mode throws.
+  void push_back(const TransectLine &line);
+  // appends the rows of other under the same rule
+  void append(const TransectTable &other);
+  void reserve(size_t n);
+  void clear();
+};
+
+inline Point TransectView::left_edge() const {
+  return {table->left_x[i], table->left_y[i]};
+}
+inline Point TransectView::right_edge() const {
+  return {table->right_x[i], table->right_y[i]};
+}
+inline Point TransectView::ref_point() const {
+  return {table->ref_x[i], table->ref_y[i]};
+}
+inline Point TransectView::base_point() const {
+  return {table->base_x[i], table->base_y[i]};
+}
+inline int TransectView::transect_id() const { return table->transect_id[i]; }
+inline int TransectView::baseline_id() const { return table->baseline_id[i]; }
+inline double TransectView::change_rate() const {
+  return table->change_rate[i];
+}
+inline IntersectRange TransectView::intersects() const {
+  return table->intersects[i];
+}
+inline std::span<const std::pair<int, int>> TransectView::grid_cells() const {
+  return table->grid_cells(i);
+}
+inline TransectQuery TransectView::query() const { return table->query(i); }
+
+// Transects along the baseline, appended to out; their reference points are
+// added to the baseline's vertices.
+void create_transects_from_baseline(Baseline &, TransectTable &out);
+TransectTable create_transects_from_baseline(Baseline &);
 
-std::vector<std::unique_ptr<TransectLine>> load_transects_from_shp(
+TransectTable load_transects_from_shp(
     const std::filesystem::path &transect_shp_path);
 
-void save_transect(const std::vector<std::unique_ptr<TransectLine>> &transects,
-                   const std::string &prj, bool save_as_point = false);
+void save_transect(const TransectTable &transects, const std::string &prj,
+                   bool save_as_point = false);
 
 }  // namespace dsas
 
@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <cassert>
 #include <concepts>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -17,8 +18,10 @@
 #include <tuple>
 #include <vector>
 
+#include "diagnostics.hpp"
 #include "exception.hpp"
 #include "geometry.hpp"
+#include "predicates.hpp"
 
 namespace dsas {
 
@@ -52,17 +55,15 @@ inline bool testRectangularOfIntersection(const dsas::Point &p1,
          (l_y_max >= r_y_min);
 }
 
+// Straddle test with adaptive orientation predicates, so the sign of each
+// cross product is exact even for nearly collinear points.
 inline bool isTwoSegmentIntersected(const dsas::Point &p1,
                                     const dsas::Point &p2,
                                     const dsas::Point &p3,
                                     const dsas::Point &p4) {
   if (testRectangularOfIntersection(p1, p2, p3, p4)) {
-    if ((calCrossOfTwoVectors(p3, p1, p3, p4) *
-             calCrossOfTwoVectors(p3, p2, p3, p4) <=
-         0) &&
-        (calCrossOfTwoVectors(p2, p3, p2, p1) *
-             calCrossOfTwoVectors(p2, p4, p2, p1) <=
-         0)) {
+    if (opposite_signs(orient2d(p1, p4, p3), orient2d(p2, p4, p3)) &&
+        opposite_signs(orient2d(p3, p1, p2), orient2d(p4, p1, p2))) {
       return true;
     } else {
       return false;
@@ -72,6 +73,9 @@ inline bool isTwoSegmentIntersected(const dsas::Point &p1,
   }
 }
 
+// Intersection of the lines through p1, p2 and p3, p4. Fails (silently, the
+// case is counted in diagnostics.parallel_segments) when they are (nearly)
+// parallel; callers then fall back to a midpoint.
 inline bool computeIntersectPoint(const Point &p1, const Point &p2,
                                   const Point &p3, const Point &p4,
                                   Point &output) noexcept {
@@ -83,7 +87,7 @@ inline bool computeIntersectPoint(const Point &p1, const Point &p2,
   const double a1 = y3 - y4, b1 = x4 - x3, c1 = x3 * y4 - x4 * y3;
   const double d = a0 * b1 - a1 * b0;
   if (std::abs(d) < 1e-4) {
-    std::cout << "two line are the same\n";
+    diagnostics.parallel_segments.fetch_add(1, std::memory_order_relaxed);
     return false;
   } else {
     const double x = (b0 * c1 - b1 * c0) / d;
@@ -253,6 +257,9 @@ void save_points(const std::vector<T *> &shapes, const std::string &prj,
 double least_square(const std::vector<long long> &x,
                     const std::vector<double> &y);
 
+// Same over n points of a day-number axis, e.g. per-thread scratch arrays.
+double least_square(const std::int32_t *x, const double *y, size_t n);
+
 // Extracts the projection string from a vector file.
 // For .shp: reads the adjacent .prj sidecar (returns WKT).
 // For .geojson/.json: extracts the "crs"."properties"."name" value (e.g.
@@ -226,4 +226,65 @@ TEST_F(CLITest, test_invalid_transect_orientation) {
                   (char *)"bogus"};
   EXPECT_EXIT(parse_args(sizeof(args) / sizeof(args[0]), args),
               ::testing::ExitedWithCode(1), "Invalid --transect-orientation");
-}
\ No newline at end of file
+}
+TEST_F(CLITest, test_spatial_index_rtree) {
+  char *args[] = {(char *)"dsas",
+                  (char *)"cal",
+                  (char *)"--transect",
+                  (char *)"trans.shp",
+                  (char *)"--shoreline",
+                  (char *)"shores.shp",
+                  (char *)"--index",
+                  (char *)"rtree"};
+  parse_args(sizeof(args) / sizeof(args[0]), args);
+  EXPECT_TRUE(options.build_index);
+  EXPECT_EQ(options.spatial_index, Options::SpatialIndex::RTree);
+}
+
+TEST_F(CLITest, test_grid_sizing_cost) {
+  char *args[] = {(char *)"dsas",
+                  (char *)"cal",
+                  (char *)"--transect",
+                  (char *)"trans.shp",
+                  (char *)"--shoreline",
+                  (char *)"shores.shp",
+                  (char *)"-bi",
+                  (char *)"--grid-sizing",
+                  (char *)"cost"};
+  parse_args(sizeof(args) / sizeof(args[0]), args);
+  EXPECT_EQ(options.grid_sizing, Options::GridSizing::CostModel);
+  EXPECT_EQ(options.spatial_index, Options::SpatialIndex::Grid);
+}
+
+TEST_F(CLITest, test_thread_stats) {
+  char *args[] = {(char *)"dsas",
+                  (char *)"cal",
+                  (char *)"--transect",
+                  (char *)"trans.shp",
+                  (char *)"--shoreline",
+                  (char *)"shores.shp",
+                  (char *)"--thread-stats"};
+  parse_args(sizeof(args) / sizeof(args[0]), args);
+  EXPECT_TRUE(options.thread_stats);
+  EXPECT_TRUE(options.write_intersects);
+}
+
+TEST_F(CLITest, test_no_intersects) {
+  char *args[] = {(char *)"dsas",       (char *)"--baseline",
+                  (char *)"base.shp",   (char *)"--shoreline",
+                  (char *)"shores.shp", (char *)"--no-intersects"};
+  parse_args(sizeof(args) / sizeof(args[0]), args);
+  EXPECT_FALSE(options.write_intersects);
+}
+
+TEST_F(CLITest, test_invalid_spatial_index) {
+  char *args[] = {(char *)"dsas",
+                  (char *)"--baseline",
+                  (char *)"base.shp",
+                  (char *)"--shoreline",
+                  (char *)"shores.shp",
+                  (char *)"--index",
+                  (char *)"quadtree"};
+  EXPECT_EXIT(parse_args(sizeof(args) / sizeof(args[0]), args),
+              ::testing::ExitedWithCode(1), "Invalid --index");
+}
@@ -3,8 +3,14 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <initializer_list>
 #include <memory>
 #include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <utility>
 
 #include "intersect.hpp"
 constexpr double TOL = 1e-4;
@@ -13,7 +19,7 @@ using namespace dsas;
 class DsasTest : public ::testing::Test {
  protected:
   std::vector<Baseline> baselines;
-  std::vector<std::unique_ptr<TransectLine>> transects;
+  TransectTable transects;
   std::vector<std::unique_ptr<Shoreline>> shorelines;
 
   void SetUp() override {
@@ -57,6 +63,38 @@ TEST_F(DsasTest, test_generate_intersects_with_grids) {
   ASSERT_EQ(intersects.size(), 4);
 }
 
+TEST_F(DsasTest, test_generate_intersects_with_rtree) {
+  auto transects = generate_transects(baselines);
+  ASSERT_EQ(transects.size(), 4);
+
+  auto rtree = build_shoreline_rtree(shorelines);
+
+  auto intersects = generate_intersects(transects, rtree);
+
+  ASSERT_EQ(intersects.size(), 4);
+}
+
+TEST_F(DsasTest, test_concurrent_passes_keep_their_balance) {
+  // two passes at once, each reporting to its own LoopBalance
+  auto grid_transects = generate_transects(baselines);
+  auto rtree_transects = generate_transects(baselines);
+  const auto grids = build_spatial_grids(shorelines, grid_transects);
+  const auto rtree = build_shoreline_rtree(shorelines);
+  LoopBalance grid_balance, rtree_balance;
+  IntersectTable grid_intersects, rtree_intersects;
+  std::thread other([&] {
+    rtree_intersects =
+        generate_intersects(rtree_transects, rtree, &rtree_balance);
+  });
+  grid_intersects = generate_intersects(grid_transects, grids, &grid_balance);
+  other.join();
+
+  ASSERT_EQ(grid_intersects.size(), 4);
+  ASSERT_EQ(rtree_intersects.size(), 4);
+  EXPECT_FALSE(grid_balance.busy_seconds.empty());
+  EXPECT_FALSE(rtree_balance.busy_seconds.empty());
+}
+
 TEST_F(DsasTest, test_generate_intersects_without_grids) {
   auto transects = generate_transects(baselines);
   ASSERT_EQ(transects.size(), 4);
@@ -67,12 +105,6 @@ TEST_F(DsasTest, test_generate_intersects_without_grids) {
 }
 
 TEST_F(DsasTest, test_linearRegressionRate) {
-  // it won't used for rate
-  Point fake_point{0, 0};
-  int fake_tid{0};
-  int fake_bid{0};
-  int fake_sid{0};
-
   dsas::Date date1{2000, 1, 1};
   dsas::Date date2{2010, 1, 1};
   dsas::Date date3{2020, 1, 1};
@@ -80,98 +112,219 @@ TEST_F(DsasTest, test_linearRegressionRate) {
   double dist2ref2 = 1;
   double dist2ref3 = 2;
 
-  {
-    std::vector<IntersectPoint *> intersections;
-    IntersectPoint p1{fake_point, fake_tid, fake_sid,
-                      fake_bid,   date1,    dist2ref1};
-    IntersectPoint p2{fake_point, fake_tid, fake_sid,
-                      fake_bid,   date2,    dist2ref2};
-    IntersectPoint p3{fake_point, fake_tid, fake_sid,
-                      fake_bid,   date3,    dist2ref3};
-
-    intersections.push_back(&p1);
-    intersections.push_back(&p2);
-    intersections.push_back(&p3);
-
-    double ans = linearRegressRate(intersections);
+  // rate of a transect whose rows are the given (date, distance) pairs, with
+  // an unrelated row on either side; the point is not used for the rate
+  auto rate = [](std::initializer_list<std::pair<Date, double>> rows) {
+    IntersectTable intersections;
+    auto add = [&](const Date &date, double distance) {
+      intersections.push_back(IntersectRow{
+          0, 0, 0, 0, 0, date.packed(),
+          static_cast<std::int32_t>(date.julian_day()), distance});
+    };
+    add(Date{1990, 1, 1}, 100);
+    for (const auto &[date, distance] : rows) add(date, distance);
+    add(Date{1990, 1, 1}, -100);
+    return linearRegressRate(intersections, IntersectRange{1, rows.size()});
+  };
+
+  ASSERT_NEAR(
+      rate({{date1, dist2ref1}, {date2, dist2ref2}, {date3, dist2ref3}}), 0.1,
+      TOL);
+  ASSERT_NEAR(rate({{date3, dist2ref3}, {date1, dist2ref1}}), 0.1, TOL);
+  ASSERT_NEAR(rate({{date1, dist2ref1}}), 0, TOL);
+  EXPECT_THROW(rate({}), std::runtime_error);
+  EXPECT_THROW(rate({{date1, dist2ref1}, {date1, dist2ref1}}),
+               std::runtime_error);
+  // dates are told apart as parsed, even when they share a day number
+  EXPECT_NO_THROW(rate({{Date{2000, 2, 31}, 0}, {Date{2000, 3, 2}, 1}}));
+  ASSERT_NEAR(rate({{Date{2000, 1, 0}, dist2ref1},
+                    {Date{2010, 1, 0}, dist2ref2},
+                    {Date{2020, 1, 0}, dist2ref3}}),
+              0.1, TOL);
+
+  dsas::options.intersection_mode = dsas::Options::IntersectionMode::Closest;
+  EXPECT_NEAR(
+      rate({{date1, dist2ref1}, {date2, dist2ref2}, {date2, dist2ref3}}), 0.1,
+      TOL);
+  dsas::options.intersection_mode = dsas::Options::IntersectionMode::Farthest;
+  EXPECT_NEAR(
+      rate({{date1, dist2ref1}, {date2, dist2ref3}, {date2, dist2ref2}}), 0.2,
+      TOL);
+}
 
-    ASSERT_NEAR(ans, 0.1, TOL);
+TEST_F(DsasTest, test_intersect_ranges) {
+  const std::filesystem::path shoreline_path{std::string(TEST_DATA_DIR) +
+                                             "/sample_shorelines.geojson"};
+  const std::filesystem::path transect_path{std::string(TEST_DATA_DIR) +
+                                            "/sample_transects.geojson"};
+  auto sample_shorelines = load_shorelines_shp(shoreline_path, "Date");
+  auto transects = load_transects_from_shp(transect_path);
+  auto intersects = generate_intersects(transects, sample_shorelines);
+  ASSERT_FALSE(intersects.empty());
+
+  // the ranges of the transects cover the table in transect order
+  size_t next = 0;
+  for (size_t t = 0; t < transects.size(); ++t) {
+    const auto range = transects[t].intersects();
+    if (range.empty()) continue;
+    ASSERT_EQ(range.first, next);
+    for (size_t i = range.first; i < range.first + range.count; ++i) {
+      ASSERT_EQ(intersects.transect_id[i], transects[t].transect_id());
+    }
+    next += range.count;
   }
+  ASSERT_EQ(next, intersects.size());
 
-  {
-    std::vector<IntersectPoint *> intersections;
-    IntersectPoint p1{fake_point, fake_tid, fake_sid,
-                      fake_bid,   date1,    dist2ref1};
-    IntersectPoint p2{fake_point, fake_tid, fake_sid,
-                      fake_bid,   date2,    dist2ref2};
-
-    intersections.push_back(&p1);
-    intersections.push_back(&p2);
-
-    double ans = linearRegressRate(intersections);
+  // and the same table comes out of every run
+  auto again = generate_intersects(transects, sample_shorelines);
+  ASSERT_EQ(again.transect_id, intersects.transect_id);
+  ASSERT_EQ(again.shoreline_id, intersects.shoreline_id);
+  ASSERT_EQ(again.distance, intersects.distance);
+}
 
-    ASSERT_NEAR(ans, 0.1, TOL);
+TEST_F(DsasTest, test_grid_intersects_match_brute_force) {
+  const std::filesystem::path shoreline_path{std::string(TEST_DATA_DIR) +
+                                             "/sample_shorelines.geojson"};
+  const std::filesystem::path transect_path{std::string(TEST_DATA_DIR) +
+                                            "/sample_transects.geojson"};
+  auto sample_shorelines = load_shorelines_shp(shoreline_path, "Date");
+
+  auto collect = [](const IntersectTable &table) {
+    std::vector<std::tuple<int, int, double>> out;
+    for (size_t i = 0; i < table.size(); ++i) {
+      out.emplace_back(table.transect_id[i], table.shoreline_id[i],
+                       table.distance[i]);
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+  };
+
+  auto brute_transects = load_transects_from_shp(transect_path);
+  auto expected =
+      collect(generate_intersects(brute_transects, sample_shorelines));
+  ASSERT_FALSE(expected.empty());
+
+  for (auto [sizing, store_transect_cells] :
+       {std::pair{Options::GridSizing::Median, false},
+        std::pair{Options::GridSizing::Median, true},
+        std::pair{Options::GridSizing::CostModel, false}}) {
+    options.grid_sizing = sizing;
+    auto transects = load_transects_from_shp(transect_path);
+    auto grids =
+        build_spatial_grids(sample_shorelines, transects, store_transect_cells);
+    auto actual = collect(generate_intersects(transects, grids));
+    ASSERT_EQ(actual.size(), expected.size());
+    for (size_t i = 0; i < actual.size(); ++i) {
+      ASSERT_EQ(std::get<0>(actual[i]), std::get<0>(expected[i]));
+      ASSERT_EQ(std::get<1>(actual[i]), std::get<1>(expected[i]));
+      ASSERT_NEAR(std::get<2>(actual[i]), std::get<2>(expected[i]), TOL);
+    }
   }
+}
 
-  {
-    std::vector<IntersectPoint *> intersections;
-    IntersectPoint p1{fake_point, fake_tid, fake_sid,
-                      fake_bid,   date1,    dist2ref1};
-
-    intersections.push_back(&p1);
-
-    double ans = linearRegressRate(intersections);
-
-    ASSERT_NEAR(ans, 0, TOL);
+TEST_F(DsasTest, test_rtree_intersects_match_brute_force) {
+  const std::filesystem::path shoreline_path{std::string(TEST_DATA_DIR) +
+                                             "/sample_shorelines.geojson"};
+  const std::filesystem::path transect_path{std::string(TEST_DATA_DIR) +
+                                            "/sample_transects.geojson"};
+  auto sample_shorelines = load_shorelines_shp(shoreline_path, "Date");
+
+  auto collect = [](const IntersectTable &table) {
+    std::vector<std::tuple<int, int, double>> out;
+    for (size_t i = 0; i < table.size(); ++i) {
+      out.emplace_back(table.transect_id[i], table.shoreline_id[i],
+                       table.distance[i]);
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+  };
+
+  auto brute_transects = load_transects_from_shp(transect_path);
+  auto expected =
+      collect(generate_intersects(brute_transects, sample_shorelines));
+  ASSERT_FALSE(expected.empty());
+
+  auto transects = load_transects_from_shp(transect_path);
+  auto rtree = build_shoreline_rtree(sample_shorelines);
+  auto actual = collect(generate_intersects(transects, rtree));
+  ASSERT_EQ(actual.size(), expected.size());
+  for (size_t i = 0; i < actual.size(); ++i) {
+    ASSERT_EQ(std::get<0>(actual[i]), std::get<0>(expected[i]));
+    ASSERT_EQ(std::get<1>(actual[i]), std::get<1>(expected[i]));
+    ASSERT_NEAR(std::get<2>(actual[i]), std::get<2>(expected[i]), TOL);
   }
+}
 
-  {
-    std::vector<IntersectPoint *> intersections;
-    EXPECT_THROW(linearRegressRate(intersections), std::runtime_error);
+TEST_F(DsasTest, test_generate_rates_match_intersects) {
+  const std::filesystem::path shoreline_path{std::string(TEST_DATA_DIR) +
+                                             "/sample_shorelines.geojson"};
+  const std::filesystem::path transect_path{std::string(TEST_DATA_DIR) +
+                                            "/sample_transects.geojson"};
+  auto sample_shorelines = load_shorelines_shp(shoreline_path, "Date");
+
+  auto expected = load_transects_from_shp(transect_path);
+  auto intersects = generate_intersects(expected, sample_shorelines);
+  ASSERT_FALSE(intersects.empty());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    if (!expected.intersects[i].empty()) {
+      expected.change_rate[i] =
+          linearRegressRate(intersects, expected.intersects[i]);
+    }
   }
 
-  {
-    std::vector<IntersectPoint *> intersections;
-    IntersectPoint p1{fake_point, fake_tid, fake_sid,
-                      fake_bid,   date1,    dist2ref1};
-
-    intersections.push_back(&p1);
-    intersections.push_back(&p1);
+  auto check = [&](const TransectTable &actual) {
+    ASSERT_EQ(actual.size(), expected.size());
+    for (size_t i = 0; i < actual.size(); ++i) {
+      ASSERT_TRUE(actual[i].intersects().empty());
+      ASSERT_NEAR(actual[i].change_rate(), expected[i].change_rate(), TOL);
+    }
+  };
+  auto brute = load_transects_from_shp(transect_path);
+  generate_rates(brute, sample_shorelines);
+  check(brute);
+
+  auto gridded = load_transects_from_shp(transect_path);
+  generate_rates(gridded, build_spatial_grids(sample_shorelines, gridded));
+  check(gridded);
+
+  auto indexed = load_transects_from_shp(transect_path);
+  generate_rates(indexed, build_shoreline_rtree(sample_shorelines));
+  check(indexed);
+}
 
-    EXPECT_THROW(linearRegressRate(intersections), std::runtime_error);
-  }
+TEST_F(DsasTest, test_generate_rates_rethrows) {
+  // a second shoreline of the same date makes every rate undefined
+  std::vector<Point> shore_vertices{{0, 2}, {1, 2}, {2, 2}, {3, 2}};
+  shorelines.push_back(
+      std::make_unique<Shoreline>(shore_vertices, 1, Date{2000, 1, 1}));
+  auto transects = generate_transects(baselines);
+  EXPECT_THROW(generate_rates(transects, shorelines), std::runtime_error);
+}
 
-  {
-    std::vector<IntersectPoint *> intersections;
-    IntersectPoint p1{fake_point, fake_tid, fake_sid,
-                      fake_bid,   date1,    dist2ref1};
-    IntersectPoint p2{fake_point, fake_tid, fake_sid,
-                      fake_bid,   date2,    dist2ref2};
-    IntersectPoint p3{fake_point, fake_tid, fake_sid,
-                      fake_bid,   date2,    dist2ref3};
-
-    intersections.push_back(&p1);
-    intersections.push_back(&p2);
-    intersections.push_back(&p3);
-    dsas::options.intersection_mode = dsas::Options::IntersectionMode::Closest;
-
-    EXPECT_NEAR(linearRegressRate(intersections), 0.1, TOL);
+TEST_F(DsasTest, test_set_change_rates) {
+  const std::filesystem::path shoreline_path{std::string(TEST_DATA_DIR) +
+                                             "/sample_shorelines.geojson"};
+  const std::filesystem::path transect_path{std::string(TEST_DATA_DIR) +
+                                            "/sample_transects.geojson"};
+  auto sample_shorelines = load_shorelines_shp(shoreline_path, "Date");
+  auto transects = load_transects_from_shp(transect_path);
+  auto intersects = generate_intersects(transects, sample_shorelines);
+  ASSERT_FALSE(intersects.empty());
+
+  set_change_rates(transects, intersects);
+  // the same rates, bit for bit, as one call per transect in order
+  for (size_t i = 0; i < transects.size(); ++i) {
+    const auto range = transects[i].intersects();
+    const double expected =
+        range.empty() ? 0 : linearRegressRate(intersects, range);
+    ASSERT_EQ(transects[i].change_rate(), expected);
   }
 
-  {
-    std::vector<IntersectPoint *> intersections;
-    IntersectPoint p1{fake_point, fake_tid, fake_sid,
-                      fake_bid,   date1,    dist2ref1};
-    IntersectPoint p2{fake_point, fake_tid, fake_sid,
-                      fake_bid,   date2,    dist2ref2};
-    IntersectPoint p3{fake_point, fake_tid, fake_sid,
-                      fake_bid,   date2,    dist2ref3};
-
-    intersections.push_back(&p1);
-    intersections.push_back(&p2);
-    intersections.push_back(&p3);
-    dsas::options.intersection_mode = dsas::Options::IntersectionMode::Farthest;
-
-    EXPECT_NEAR(linearRegressRate(intersections), 0.2, TOL);
-  }
-}
\ No newline at end of file
+  // two shorelines of the same date make the fixture's rates undefined
+  std::vector<Point> shore_vertices{{0, 2}, {1, 2}, {2, 2}, {3, 2}};
+  shorelines.push_back(
+      std::make_unique<Shoreline>(shore_vertices, 1, Date{2000, 1, 1}));
+  transects = generate_transects(baselines);
+  intersects = generate_intersects(transects, shorelines);
+  EXPECT_THROW(set_change_rates(transects, intersects), std::runtime_error);
+}
@@ -0,0 +1,115 @@
+#include "geojson.hpp"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace dsas;
+
+namespace {
+std::filesystem::path write_tmp(const char *name, const std::string &text) {
+  auto tmp = std::filesystem::temp_directory_path() / name;
+  std::ofstream f(tmp);
+  f << text;
+  return tmp;
+}
+}  // namespace
+
+TEST(GeoJsonTest, test_read_features) {
+  const auto tmp = write_tmp("stream.geojson", R"({
+    "type": "FeatureCollection",
+    "crs": {"type": "name", "properties": {"name": "EPSG:32617"}},
+    "features": [
+      {"type": "Feature",
+       "properties": {"Date": "2000/01/01", "Id": 7, "Tags": ["a", 1],
+                      "Meta": {"x": 1}, "Ok": true},
+       "geometry": {"type": "LineString",
+                    "coordinates": [[0, 0, 5], [1.5, 2], [3, 4]]}},
+      {"type": "Feature",
+       "geometry": {"type": "MultiLineString",
+                    "coordinates": [[[0, 0], [1, 1]], [[2, 2], [3, 3], [4, 4]]]},
+       "properties": {"Date": "2001/01/01"}}
+    ]})");
+
+  std::vector<GeoJsonFeature> features;
+  GeoJsonCrs crs;
+  read_geojson_features(
+      tmp, [&](const GeoJsonFeature &feature) { features.push_back(feature); },
+      &crs);
+  ASSERT_EQ(features.size(), 2);
+  EXPECT_EQ(crs.projection(tmp), "EPSG:32617");
+
+  const auto &line = features[0];
+  EXPECT_EQ(line.geometry_type, "LineString");
+  ASSERT_EQ(line.num_parts(), 1);
+  ASSERT_EQ(line.points.size(), 3);
+  EXPECT_EQ(line.points[0].x, 0);
+  EXPECT_EQ(line.points[1].x, 1.5);
+  EXPECT_EQ(line.points[2].y, 4);
+  ASSERT_NE(line.property("Id"), nullptr);
+  EXPECT_EQ(line.property("Id")->get<int>(), 7);
+  EXPECT_EQ(line.property("Date")->get<std::string>(), "2000/01/01");
+  EXPECT_TRUE(line.property("Tags")->is_null());
+  EXPECT_TRUE(line.property("Meta")->is_null());
+  EXPECT_TRUE(line.property("Ok")->get<bool>());
+  EXPECT_EQ(line.property("x"), nullptr);
+  EXPECT_EQ(line.property("name"), nullptr);
+
+  const auto &multi = features[1];
+  EXPECT_EQ(multi.geometry_type, "MultiLineString");
+  ASSERT_EQ(multi.num_parts(), 2);
+  ASSERT_EQ(multi.part(0).size(), 2);
+  ASSERT_EQ(multi.part(1).size(), 3);
+  EXPECT_EQ(multi.part(1)[0].x, 2);
+  EXPECT_EQ(multi.property("Date")->get<std::string>(), "2001/01/01");
+}
+
+TEST(GeoJsonTest, test_read_crs) {
+  // stops once the crs is read, before the truncated features
+  const auto first = write_tmp(
+      "crs_first.geojson",
+      R"({"type":"FeatureCollection","crs":{"type":"name","properties":{"name":"EPSG:3857"}},"features":[{"type":)");
+  const auto crs = read_geojson_crs(first);
+  EXPECT_TRUE(crs.present);
+  EXPECT_EQ(crs.type, "name");
+  EXPECT_EQ(crs.projection(first), "EPSG:3857");
+
+  // a crs after the features is still found
+  const auto last = write_tmp(
+      "crs_last.geojson",
+      R"({"type":"FeatureCollection","features":[{"type":"Feature","properties":{"name":"x"},"geometry":null}],"crs":{"type":"name","properties":{"name":"EPSG:2193"}}})");
+  EXPECT_EQ(read_geojson_crs(last).projection(last), "EPSG:2193");
+
+  const auto none = write_tmp("crs_none.geojson",
+                              R"({"type":"FeatureCollection","features":[]})");
+  EXPECT_FALSE(read_geojson_crs(none).present);
+  EXPECT_EQ(read_geojson_crs(none).projection(none), "EPSG:4326");
+
+  const auto null_crs = write_tmp(
+      "crs_null.geojson", R"({"type":"FeatureCollection","crs":null})");
+  const auto null_read = read_geojson_crs(null_crs);
+  EXPECT_TRUE(null_read.present);
+  ASSERT_THROW(static_cast<void>(null_read.projection(null_crs)),
+               std::runtime_error);
+}
+
+TEST(GeoJsonTest, test_read_errors) {
+  auto ignore = [](const GeoJsonFeature &) {};
+  ASSERT_THROW(read_geojson_features("/nonexistent/path.geojson", ignore),
+               std::runtime_error);
+
+  const auto short_position = write_tmp(
+      "short_position.geojson",
+      R"({"type":"FeatureCollection","features":[{"type":"Feature","properties":{},"geometry":{"type":"LineString","coordinates":[[0,0],[1]]}}]})");
+  ASSERT_THROW(read_geojson_features(short_position, ignore),
+               std::runtime_error);
+
+  const auto truncated = write_tmp(
+      "truncated.geojson",
+      R"({"type":"FeatureCollection","features":[{"type":"Feature",)");
+  ASSERT_THROW(read_geojson_features(truncated, ignore),
+               nlohmann::json::parse_error);
+}
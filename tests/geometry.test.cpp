@@ -72,3 +72,29 @@ TEST(LineTest, test_find_intersection_nullopt) {
   auto result = line.find_intersection(p3, p4);
   ASSERT_FALSE(result.has_value());
 }
+
+TEST(DateTest, test_julian_day_round_trip) {
+  ASSERT_EQ(Date({2000, 1, 1}).julian_day(), 2451545);
+  for (const Date date : {Date{1600, 2, 29}, Date{1899, 12, 31},
+                          Date{2000, 2, 29}, Date{2024, 3, 1},
+                          Date{2100, 2, 28}}) {
+    ASSERT_EQ(Date::from_julian_day(date.julian_day()), date);
+  }
+  for (long long jdn = 2400000; jdn < 2500000; jdn += 97) {
+    ASSERT_EQ(Date::from_julian_day(jdn).julian_day(), jdn);
+  }
+}
+
+TEST(DateTest, test_format_date) {
+  char out[max_date_chars];
+  auto format = [&](const Date &date) {
+    return std::string(out, format_date(date, out));
+  };
+  ASSERT_EQ(format({2000, 1, 1}), "2000/01/01");
+  ASSERT_EQ(format({1999, 12, 31}), "1999/12/31");
+  ASSERT_EQ(format({987, 6, 5}), "987/06/05");
+  ASSERT_EQ(format({123456, 10, 9}), "123456/10/09");
+  ASSERT_EQ(format({-999999, 1, 2}), "-999999/01/02");
+  ASSERT_THROW(format({12345678, 1, 1}), std::runtime_error);
+  ASSERT_THROW(format({-1000000, 1, 1}), std::runtime_error);
+}
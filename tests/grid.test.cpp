@@ -2,9 +2,27 @@
 
 #include <gtest/gtest.h>
 
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "transect.hpp"
+
 using namespace dsas;
 #define TOL 1e-4
 
+// number of cells holding at least one segment
+static size_t occupied_cells(const Grids &grids) {
+  size_t n = 0;
+  for (size_t c = 0; c < grids.num_cells(); ++c) {
+    if (!grids.cell(c).empty()) n++;
+  }
+  return n;
+}
+
 TEST(GridTest, test_compute_grid_bound) {
   std::vector<Point> shore_vertices{{0, 0}, {1, 1}, {2, 2}, {3, 3}};
   dsas::Date t_date{2000, 1, 1};
@@ -12,14 +30,14 @@ TEST(GridTest, test_compute_grid_bound) {
   std::vector<std::unique_ptr<Shoreline>> shorelines;
   shorelines.push_back(std::move(shoreline));
 
-  compute_grid_bound(shorelines);
-  ASSERT_NEAR(Grid::grid_size, 1.4142, TOL);
-  ASSERT_NEAR(Grid::grids_bound_left_bottom_x, -0.7071, TOL);
-  ASSERT_NEAR(Grid::grids_bound_left_bottom_y, -0.7071, TOL);
-  ASSERT_NEAR(Grid::grids_bound_right_top_y, 3.7071, TOL);
-  ASSERT_NEAR(Grid::grids_bound_right_top_y, 3.7071, TOL);
-  ASSERT_EQ(Grid::grid_nx, 3);
-  ASSERT_EQ(Grid::grid_ny, 3);
+  auto bound = compute_grid_bound(shorelines);
+  ASSERT_NEAR(bound.grid_size, 1.4142, TOL);
+  ASSERT_NEAR(bound.left_bottom_x, -0.7071, TOL);
+  ASSERT_NEAR(bound.left_bottom_y, -0.7071, TOL);
+  ASSERT_NEAR(bound.right_top_x, 3.7071, TOL);
+  ASSERT_NEAR(bound.right_top_y, 3.7071, TOL);
+  ASSERT_EQ(bound.nx, 3);
+  ASSERT_EQ(bound.ny, 3);
 }
 
 TEST(GridTest, test_build_transect_index) {
@@ -30,60 +48,17 @@ TEST(GridTest, test_build_transect_index) {
   options.intersection_mode = dsas::Options::IntersectionMode::Closest;
   auto baseline = std::make_unique<Baseline>(points, 0);
   auto transects_lines = create_transects_from_baseline(*baseline);
-  Grid::grid_size = 1;
-  Grid::grids_bound_left_bottom_x = 0;
-  Grid::grids_bound_left_bottom_y = 0;
-  Grid::grids_bound_right_top_x = 3;
-  Grid::grids_bound_right_top_y = 3;
-  build_transect_index(transects_lines);
-
-  {
-    auto &transect = transects_lines[0];
-    ASSERT_EQ(transect->grid_index.size(), 1);
-    ASSERT_EQ(transect->grid_index[0].first, 0);
-    ASSERT_EQ(transect->grid_index[0].second, 0);
-  }
-
-  {
-    auto &transect = transects_lines[1];
-    ASSERT_EQ(transect->grid_index.size(), 1);
-    ASSERT_EQ(transect->grid_index[0].first, 0);
-    ASSERT_EQ(transect->grid_index[0].second, 0);
-  }
-
-  {
-    auto &transect = transects_lines[2];
-    ASSERT_EQ(transect->grid_index.size(), 1);
-    ASSERT_EQ(transect->grid_index[0].first, 0);
-    ASSERT_EQ(transect->grid_index[0].second, 0);
-  }
-
-  {
-    auto &transect = transects_lines[3];
-    ASSERT_EQ(transect->grid_index.size(), 1);
-    ASSERT_EQ(transect->grid_index[0].first, 1);
-    ASSERT_EQ(transect->grid_index[0].second, 0);
-  }
-
-  {
-    auto &transect = transects_lines[4];
-    ASSERT_EQ(transect->grid_index.size(), 1);
-    ASSERT_EQ(transect->grid_index[0].first, 1);
-    ASSERT_EQ(transect->grid_index[0].second, 0);
-  }
-
-  {
-    auto &transect = transects_lines[5];
-    ASSERT_EQ(transect->grid_index.size(), 1);
-    ASSERT_EQ(transect->grid_index[0].first, 2);
-    ASSERT_EQ(transect->grid_index[0].second, 0);
-  }
-
-  {
-    auto &transect = transects_lines[6];
-    ASSERT_EQ(transect->grid_index.size(), 1);
-    ASSERT_EQ(transect->grid_index[0].first, 2);
-    ASSERT_EQ(transect->grid_index[0].second, 0);
+  const auto bound = make_grid_bound(0, 0, 3, 3, 1);
+  build_transect_index(transects_lines, bound);
+
+  // one cell each, along the bottom row
+  const int expected_i[]{0, 0, 0, 1, 1, 2, 2};
+  ASSERT_EQ(transects_lines.size(), 7);
+  for (size_t k = 0; k < transects_lines.size(); k++) {
+    const auto cells = transects_lines[k].grid_cells();
+    ASSERT_EQ(cells.size(), 1);
+    ASSERT_EQ(cells[0].first, expected_i[k]);
+    ASSERT_EQ(cells[0].second, 0);
   }
 }
 
@@ -95,24 +70,16 @@ TEST(GridTest, test_build_transect_out_of_bound) {
   options.intersection_mode = dsas::Options::IntersectionMode::Closest;
   auto baseline = std::make_unique<Baseline>(points, 0);
   auto transects_lines = create_transects_from_baseline(*baseline);
-  Grid::grid_size = 1;
-  Grid::grids_bound_left_bottom_x = 5;
-  Grid::grids_bound_left_bottom_y = 0;
-  Grid::grids_bound_right_top_x = 6;
-  Grid::grids_bound_right_top_y = 3;
-  build_transect_index(transects_lines);
-
-  for (auto &transect : transects_lines) {
-    ASSERT_EQ(transect->grid_index.size(), 0);
+  const auto bound = make_grid_bound(5, 0, 6, 3, 1);
+  build_transect_index(transects_lines, bound);
+
+  for (size_t k = 0; k < transects_lines.size(); k++) {
+    ASSERT_EQ(transects_lines[k].grid_cells().size(), 0);
   }
 }
 
 TEST(GridTest, test_build_shoreline_index) {
-  Grid::grids_bound_left_bottom_x = 0;
-  Grid::grids_bound_left_bottom_y = 0;
-  Grid::grids_bound_right_top_x = 10;
-  Grid::grids_bound_right_top_y = 10;
-  Grid::grid_size = 3;
+  const auto bound = make_grid_bound(0, 0, 10, 10, 3);
 
   std::vector<Point> shore_vertices{{0, 0}, {1, 1}, {2, 2}, {3, 3}};
 
@@ -121,22 +88,69 @@ TEST(GridTest, test_build_shoreline_index) {
   std::vector<std::unique_ptr<Shoreline>> shorelines;
   shorelines.push_back(std::move(shoreline));
 
-  auto grids = build_shoreline_index(shorelines);
+  auto grids = build_shoreline_index(shorelines, bound);
+
+  ASSERT_EQ(occupied_cells(grids), 1);
+  ASSERT_EQ(grids.cell(0).size(), 3);
+  ASSERT_TRUE(grids.cell(1).empty());
+
+  // cells keep compact references that resolve to the shoreline vertices
+  auto seg = grids.cell(0)[1];
+  ASSERT_EQ(seg.shoreline, 0u);
+  ASSERT_EQ(seg.vertex, 1u);
+  ASSERT_EQ(grids.start(seg), Point(1, 1));
+  ASSERT_EQ(grids.end(seg), Point(2, 2));
+}
 
-  ASSERT_EQ(grids.size(), 1);
-  ASSERT_EQ(grids.count(0), 1);
-  ASSERT_EQ(grids.count(1), 0);
+TEST(GridTest, test_build_shoreline_index_matches_serial_order) {
+  // The parallel build must put every segment into exactly the cells of its
+  // bbox, in (shoreline, vertex) order, whatever the thread interleaving.
+  std::vector<std::unique_ptr<Shoreline>> shorelines;
+  for (int s = 0; s < 5; ++s) {
+    std::vector<Point> pts;
+    for (int i = 0; i < 400; ++i) {
+      pts.emplace_back(i * 0.25 + s, 20 + 10 * std::sin(i * 0.05 + s));
+    }
+    shorelines.push_back(
+        std::make_unique<Shoreline>(pts, s, dsas::Date{2000 + s, 1, 1}));
+  }
+  const auto bound = make_grid_bound(0, 0, 110, 40, 1.5);
+  auto grids = build_shoreline_index(shorelines, bound);
+
+  std::vector<std::vector<std::pair<std::uint32_t, std::uint32_t>>> expected(
+      grids.num_cells());
+  for (std::uint32_t s = 0; s < shorelines.size(); ++s) {
+    const auto &pts = shorelines[s]->shoreline_vertices_;
+    for (std::uint32_t v = 0; v + 1 < pts.size(); ++v) {
+      auto index = [&](double value, double origin, size_t n) {
+        return clamp_cell_index(cell_index(value, origin, 1.5),
+                                static_cast<int>(n));
+      };
+      const auto &a = pts[v], &b = pts[v + 1];
+      for (int i = index(std::min(a.x, b.x), 0, bound.nx);
+           i <= index(std::max(a.x, b.x), 0, bound.nx); ++i) {
+        for (int j = index(std::min(a.y, b.y), 0, bound.ny);
+             j <= index(std::max(a.y, b.y), 0, bound.ny); ++j) {
+          expected[i * bound.ny + j].emplace_back(s, v);
+        }
+      }
+    }
+  }
+  for (size_t c = 0; c < grids.num_cells(); ++c) {
+    const auto cell = grids.cell(c);
+    ASSERT_EQ(cell.size(), expected[c].size());
+    for (size_t k = 0; k < cell.size(); ++k) {
+      ASSERT_EQ(cell[k].shoreline, expected[c][k].first);
+      ASSERT_EQ(cell[k].vertex, expected[c][k].second);
+    }
+  }
 }
 
 TEST(GridTest, test_build_shoreline_index_taller_than_wide) {
   // Grid is 2 cells wide (nx=2) and 6 cells tall (ny=6).
   // The buggy formula  ix*nx+iy  maps cells (0,2) and (1,0) both to key 2.
   // The correct formula ix*ny+iy  maps them to keys 2 and 6 — distinct.
-  Grid::grids_bound_left_bottom_x = 0;
-  Grid::grids_bound_left_bottom_y = 0;
-  Grid::grids_bound_right_top_x = 2;
-  Grid::grids_bound_right_top_y = 6;
-  Grid::grid_size = 1;
+  const auto bound = make_grid_bound(0, 0, 2, 6, 1);
 
   dsas::Date date{2000, 1, 1};
 
@@ -153,30 +167,26 @@ TEST(GridTest, test_build_shoreline_index_taller_than_wide) {
   shorelines.push_back(std::move(shore_a));
   shorelines.push_back(std::move(shore_b));
 
-  auto grids = build_shoreline_index(shorelines);
+  auto grids = build_shoreline_index(shorelines, bound);
 
-  // Two segments in two distinct cells must produce two map entries.
-  // With the bug grids.size() == 1 (both collapsed into key 2).
-  ASSERT_EQ(grids.size(), 2);
+  // Two segments in two distinct cells must produce two occupied cells.
+  // With the bug only one cell (key 2) would be occupied.
+  ASSERT_EQ(occupied_cells(grids), 2);
 
   // Cell (0,2) -> key 2: holds only segment A
-  ASSERT_EQ(grids.count(2), 1);
-  ASSERT_EQ(grids.at(2)->shoreline_segs.size(), 1);
+  ASSERT_EQ(grids.cell(2).size(), 1);
+  ASSERT_EQ(grids.shoreline(grids.cell(2)[0]).shoreline_id_, 0);
 
   // Cell (1,0) -> key 6: holds only segment B
-  ASSERT_EQ(grids.count(6), 1);
-  ASSERT_EQ(grids.at(6)->shoreline_segs.size(), 1);
+  ASSERT_EQ(grids.cell(6).size(), 1);
+  ASSERT_EQ(grids.shoreline(grids.cell(1, 0)[0]).shoreline_id_, 1);
 }
 
 TEST(GridTest, test_build_shoreline_index_cell_origin) {
-  // Regression test: Grid::min_x/min_y must be the cell's world-space
+  // Regression test: the cell origin must be the cell's world-space
   // origin (left_bottom + index * grid_size), not derived from the
   // segment's own bbox or the flat cell index.
-  Grid::grids_bound_left_bottom_x = 0;
-  Grid::grids_bound_left_bottom_y = 0;
-  Grid::grids_bound_right_top_x = 10;
-  Grid::grids_bound_right_top_y = 10;
-  Grid::grid_size = 1;
+  const auto bound = make_grid_bound(0, 0, 10, 10, 1);
 
   dsas::Date d{2000, 1, 1};
   // Segment sits inside cell (ix=2, iy=2), offset from that cell's origin,
@@ -187,14 +197,13 @@ TEST(GridTest, test_build_shoreline_index_cell_origin) {
   std::vector<std::unique_ptr<Shoreline>> shores;
   shores.push_back(std::move(shore));
 
-  auto grids = build_shoreline_index(shores);
+  auto grids = build_shoreline_index(shores, bound);
 
-  ASSERT_EQ(grids.size(), 1);
-  auto &grid = grids.begin()->second;
-  ASSERT_EQ(grid->i, 2u);
-  ASSERT_EQ(grid->j, 2u);
-  ASSERT_NEAR(grid->min_x, 2.0, TOL);
-  ASSERT_NEAR(grid->min_y, 2.0, TOL);
+  ASSERT_EQ(occupied_cells(grids), 1);
+  ASSERT_EQ(grids.cell(2, 2).size(), 1);
+  auto origin = grids.cell_origin(2, 2);
+  ASSERT_NEAR(origin.x, 2.0, TOL);
+  ASSERT_NEAR(origin.y, 2.0, TOL);
 }
 
 TEST(GridTest, test_compute_grid_bound_even_segments) {
@@ -204,37 +213,131 @@ TEST(GridTest, test_compute_grid_bound_even_segments) {
   auto shore = std::make_unique<Shoreline>(pts, 0, d);
   std::vector<std::unique_ptr<Shoreline>> shores;
   shores.push_back(std::move(shore));
-  compute_grid_bound(shores);
-  ASSERT_NEAR(Grid::grid_size, sqrt(2.0), TOL);
+  auto bound = compute_grid_bound(shores);
+  ASSERT_NEAR(bound.grid_size, sqrt(2.0), TOL);
+}
+
+TEST(GridTest, test_compute_grid_bound_for_transects) {
+  // five parallel shorelines 10 m apart with 1 m segments
+  std::vector<std::unique_ptr<Shoreline>> shores;
+  for (int s = 0; s < 5; ++s) {
+    std::vector<Point> pts;
+    for (int i = 0; i <= 1000; ++i) pts.emplace_back(i, 10.0 * s);
+    shores.push_back(std::make_unique<Shoreline>(pts, s, dsas::Date{}));
+  }
+
+  // sqrt(c * L * mean / K) with K = 2 * 5000 * L / (pi * 1000 * 40)
+  auto bound = compute_grid_bound_for_transects(shores, 100, false);
+  const double expected =
+      std::sqrt(0.5 * 1.0 * std::numbers::pi * 1000 * 40 / (2 * 5000));
+  ASSERT_NEAR(bound.grid_size, expected, TOL);
+  ASSERT_NEAR(bound.left_bottom_x, 0, TOL);
+  ASSERT_NEAR(bound.right_top_y, 40, TOL);
+  ASSERT_EQ(bound.nx, static_cast<size_t>(1000 / bound.grid_size));
+
+  // short transects: the cell size never drops below ~4 cells per segment
+  bound = compute_grid_bound_for_transects(shores, 0.01, false);
+  ASSERT_NEAR(bound.grid_size, std::sqrt(1000.0 * 40 / (4 * 5000)), TOL);
+
+  // without transect statistics fall back to the median segment length
+  bound = compute_grid_bound_for_transects(shores, 0, false);
+  ASSERT_NEAR(bound.grid_size, 1, TOL);
 }
 
 TEST(GridTest, test_build_shoreline_index_clamping) {
   // Segment extends beyond grid bounds → ix/iy clamped to grid limits
-  Grid::grids_bound_left_bottom_x = 0;
-  Grid::grids_bound_left_bottom_y = 0;
-  Grid::grids_bound_right_top_x = 3;
-  Grid::grids_bound_right_top_y = 3;
-  Grid::grid_size = 1;
+  const auto bound = make_grid_bound(0, 0, 3, 3, 1);
   dsas::Date d{2000, 1, 1};
   auto shore = std::make_unique<Shoreline>(
       std::vector<Point>{{2.0, 2.0}, {4.0, 4.0}}, 0, d);
   std::vector<std::unique_ptr<Shoreline>> shores;
   shores.push_back(std::move(shore));
-  auto grids = build_shoreline_index(shores);
+  auto grids = build_shoreline_index(shores, bound);
   ASSERT_FALSE(grids.empty());
 }
 
+TEST(GridTest, test_build_shoreline_index_empty) {
+  // no shoreline segments: no cell size to pick and nothing to index
+  std::vector<std::unique_ptr<Shoreline>> shores;
+  ASSERT_THROW(build_shoreline_index(shores, compute_grid_bound(shores)),
+               std::runtime_error);
+  shores.push_back(std::make_unique<Shoreline>(std::vector<Point>{{1.0, 1.0}},
+                                               0, dsas::Date{2000, 1, 1}));
+  ASSERT_THROW(build_shoreline_index(shores, compute_grid_bound(shores)),
+               std::runtime_error);
+  ASSERT_THROW(build_shoreline_index(shores, make_grid_bound(0, 0, 3, 3, 0)),
+               std::runtime_error);
+}
+
 TEST(GridTest, test_build_transect_index_clamping) {
   // Transect extends beyond grid bounds → ix/iy clamped to grid limits
-  Grid::grids_bound_left_bottom_x = 0;
-  Grid::grids_bound_left_bottom_y = 0;
-  Grid::grids_bound_right_top_x = 3;
-  Grid::grids_bound_right_top_y = 3;
-  Grid::grid_size = 1;
+  const auto bound = make_grid_bound(0, 0, 3, 3, 1);
   Point start{2.0, 1.0}, end{4.0, 1.0};
-  auto t = std::make_unique<TransectLine>(start, end, 0, 0);
-  std::vector<std::unique_ptr<TransectLine>> transects;
-  transects.push_back(std::move(t));
-  build_transect_index(transects);
-  ASSERT_FALSE(transects[0]->grid_index.empty());
-}
\ No newline at end of file
+  TransectTable transects;
+  transects.push_back(TransectLine(start, end, 0, 0));
+  build_transect_index(transects, bound);
+  ASSERT_FALSE(transects[0].grid_cells().empty());
+}
+TEST(GridTest, test_traverse_grid_corner) {
+  // Diagonal through the corners (1,1) and (2,2): each corner also adds the
+  // two cells beside it.
+  const auto bound = make_grid_bound(0, 0, 10, 10, 1);
+  std::vector<std::pair<int, int>> cells;
+  traverse_grid(bound, Point{0.5, 0.5}, Point{2.5, 2.5},
+                [&](int i, int j) { cells.emplace_back(i, j); });
+  std::vector<std::pair<int, int>> expected{{0, 0}, {1, 0}, {0, 1}, {1, 1},
+                                            {2, 1}, {1, 2}, {2, 2}};
+  ASSERT_EQ(cells, expected);
+
+  // walking backwards visits the same cells in reverse
+  cells.clear();
+  traverse_grid(bound, Point{2.5, 2.5}, Point{0.5, 0.5},
+                [&](int i, int j) { cells.emplace_back(i, j); });
+  ASSERT_EQ(cells.size(), expected.size());
+  ASSERT_EQ(cells.front(), expected.back());
+  ASSERT_EQ(cells.back(), expected.front());
+}
+
+TEST(GridTest, test_traverse_grid_covers_segment) {
+  // Every cell holding a point of the segment must be visited, and the walk
+  // must stay linear in the segment length rather than its bbox area.
+  const auto bound = make_grid_bound(-3, 7, 1003, 1007, 10);
+  const int n = 100;
+
+  const std::vector<std::pair<Point, Point>> segments{
+      {{0, 10}, {1000, 1000}},   {{1000, 1000}, {0, 10}},
+      {{500, 8}, {510, 1006}},   {{12.5, 300}, {991.7, 290}},
+      {{-50, 500}, {2000, 600}}, {{37, 37}, {37, 900}},
+  };
+  for (const auto &[a, b] : segments) {
+    std::set<std::pair<int, int>> visited;
+    size_t calls = 0;
+    traverse_grid(bound, a, b, [&](int i, int j) {
+      visited.emplace(i, j);
+      calls++;
+    });
+    ASSERT_EQ(visited.size(), calls) << "cell visited twice";
+
+    Point lo = a, hi = b;
+    ASSERT_TRUE(clip_to_grid_bound(bound, lo, hi));
+    for (int k = 0; k <= 20000; ++k) {
+      const double t = k / 20000.0;
+      const double x = lo.x + t * (hi.x - lo.x);
+      const double y = lo.y + t * (hi.y - lo.y);
+      std::pair<int, int> cell{
+          clamp_cell_index(cell_index(x, bound.left_bottom_x, 10),
+                           n),
+          clamp_cell_index(cell_index(y, bound.left_bottom_y, 10),
+                           n)};
+      ASSERT_TRUE(visited.count(cell)) << "missed cell at " << Point(x, y);
+    }
+    ASSERT_LE(visited.size(), 2 * n + 1);
+  }
+}
+
+TEST(GridTest, test_traverse_grid_out_of_bound) {
+  const auto bound = make_grid_bound(0, 0, 3, 3, 1);
+  size_t calls = 0;
+  traverse_grid(bound, Point{-2, 5}, Point{5, 4}, [&](int, int) { calls++; });
+  ASSERT_EQ(calls, 0);
+}
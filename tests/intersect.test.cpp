@@ -2,8 +2,11 @@
 
 #include <gtest/gtest.h>
 
-#include <memory>
+#include <cstdint>
+#include <string>
+#include <utility>
 
+#include "shoreline.hpp"
 #include "utility.hpp"
 
 constexpr double TOL = 1e-4;
@@ -29,37 +32,63 @@ TEST(TestIntersect, test_save_intersects) {
   auto tmp_file = std::filesystem::temp_directory_path() / "intersects.shp";
   options.intersect_path = tmp_file.string();
 
-  {
-    std::vector<std::unique_ptr<IntersectPoint>> intersections;
-    auto p1 = std::make_unique<dsas::IntersectPoint>(
-        fake_point, fake_tid, fake_sid, fake_bid, date1, dist2ref1);
-    auto p2 = std::make_unique<dsas::IntersectPoint>(
-        fake_point, fake_tid, fake_sid, fake_bid, date2, dist2ref2);
-    auto p3 = std::make_unique<dsas::IntersectPoint>(
-        fake_point, fake_tid, fake_sid, fake_bid, date3, dist2ref3);
-
-    intersections.push_back(std::move(p1));
-    intersections.push_back(std::move(p2));
-    intersections.push_back(std::move(p3));
-    save_intersects(intersections, prj);
-  }
-  {
-    std::vector<std::unique_ptr<IntersectPoint>> intersections;
-    ASSERT_THROW(save_intersects(intersections, prj), std::runtime_error);
+  IntersectTable intersections;
+  for (const auto &[date, dist2ref] :
+       {std::pair{date1, dist2ref1}, std::pair{date2, dist2ref2},
+        std::pair{date3, dist2ref3}}) {
+    intersections.push_back(IntersectRow{
+        fake_point.x, fake_point.y, fake_tid, fake_sid, fake_bid,
+        date.packed(), static_cast<std::int32_t>(date.julian_day()),
+        dist2ref});
   }
-  {
-    std::vector<std::unique_ptr<IntersectPoint>> intersections;
-    auto p1 = std::make_unique<dsas::IntersectPoint>(
-        fake_point, fake_tid, fake_sid, fake_bid, date1, dist2ref1);
-    auto p2 = std::make_unique<dsas::IntersectPoint>(
-        fake_point, fake_tid, fake_sid, fake_bid, date2, dist2ref2);
-    auto p3 = std::make_unique<dsas::IntersectPoint>(
-        fake_point, fake_tid, fake_sid, fake_bid, date3, dist2ref3);
+  ASSERT_EQ(intersections.size(), 3);
+  ASSERT_EQ(intersections.date(1), date2);
+  save_intersects(intersections, prj);
 
-    intersections.push_back(std::move(p1));
-    intersections.push_back(std::move(p2));
-    intersections.push_back(std::move(p3));
-    prj = "INVALID_PROJ_STRING";
-    ASSERT_THROW(save_intersects(intersections, prj), std::runtime_error);
-  }
-}
\ No newline at end of file
+  ASSERT_THROW(save_intersects(IntersectTable{}, prj), std::runtime_error);
+
+  prj = "INVALID_PROJ_STRING";
+  ASSERT_THROW(save_intersects(intersections, prj), std::runtime_error);
+}
+
+TEST(TestIntersect, test_table_copy_rows) {
+  IntersectTable a, b;
+  a.resize(3);
+  b.push_back(IntersectRow{1, 2, 3, 4, 5, 6, 7, 8});
+  b.push_back(IntersectRow{9, 10, 11, 12, 13, 14, 15, 16});
+  b.push_back(IntersectRow{17, 18, 19, 20, 21, 22, 23, 24});
+  a.copy_rows(1, b, 1, 2);
+  ASSERT_EQ(a.size(), 3);
+  EXPECT_EQ(a.x[0], 0);
+  const auto row = a[1];
+  EXPECT_EQ(row.x, 9);
+  EXPECT_EQ(row.y, 10);
+  EXPECT_EQ(row.transect_id, 11);
+  EXPECT_EQ(row.shoreline_id, 12);
+  EXPECT_EQ(row.baseline_id, 13);
+  EXPECT_EQ(row.ymd, 14);
+  EXPECT_EQ(row.day, 15);
+  EXPECT_EQ(row.distance, 16);
+  EXPECT_EQ(a.distance[2], 24);
+
+  a.clear();
+  ASSERT_TRUE(a.empty());
+}
+
+TEST(TestIntersect, test_date_without_day) {
+  // "%Y" leaves the day at 0, as strptime does; the saved date keeps it
+  // rather than rolling back to the last day of the year before
+  options.date_format = "%Y";
+  const auto date = generate_date_from_str("2000");
+  ASSERT_EQ(date, (Date{2000, 1, 0}));
+
+  IntersectTable intersections;
+  intersections.push_back(IntersectRow{
+      0, 0, 0, 0, 0, date.packed(),
+      static_cast<std::int32_t>(date.julian_day()), 1});
+  ASSERT_EQ(intersections.date(0), date);
+  char out[max_date_chars];
+  ASSERT_EQ(std::string(out, format_date(intersections.date(0), out)),
+            "2000/01/00");
+  options.date_format = "%Y/%m/%d";
+}
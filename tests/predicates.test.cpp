@@ -0,0 +1,48 @@
+#include "predicates.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "diagnostics.hpp"
+#include "geometry.hpp"
+
+using namespace dsas;
+
+static int sign(double value) { return (value > 0) - (value < 0); }
+
+TEST(PredicatesTest, test_orient2d_signs) {
+  ASSERT_GT(orient2d(Point(0, 0), Point(1, 0), Point(0, 1)), 0);
+  ASSERT_LT(orient2d(Point(0, 0), Point(0, 1), Point(1, 0)), 0);
+  ASSERT_EQ(orient2d(Point(0, 0), Point(1, 1), Point(3, 3)), 0);
+  ASSERT_EQ(orient2d_exact(0, 0, 1, 1, 3, 3), 0);
+}
+
+TEST(PredicatesTest, test_orient2d_near_collinear) {
+  // Shewchuk's example: a walks over a 16 x 16 grid of neighbouring doubles
+  // around (0.5, 0.5), next to the line through b and c; the exact
+  // determinant is 12 * (ay - ax), which plain floating point often gets
+  // wrong
+  const double ulp = std::ldexp(1.0, -53);
+  const Point b(12, 12), c(24, 24);
+  diagnostics.reset();
+  for (int i = 0; i < 16; i++) {
+    for (int j = 0; j < 16; j++) {
+      const Point a(0.5 + i * ulp, 0.5 + j * ulp);
+      ASSERT_EQ(sign(orient2d(a, b, c)), sign(j - i)) << i << ", " << j;
+      ASSERT_EQ(sign(orient2d_exact(a.x, a.y, b.x, b.y, c.x, c.y)),
+                sign(j - i));
+    }
+  }
+  ASSERT_GT(diagnostics.exact_orientations, 0);
+  diagnostics.reset();
+}
+
+TEST(PredicatesTest, test_orient2d_exact_large_coordinates) {
+  // UTM-like coordinates, c one unit in the last place off the line
+  const double x = 500000.0, y = 4000000.0;
+  const double ulp = std::nextafter(y, 1e300) - y;
+  ASSERT_EQ(orient2d_exact(x, y, x + 3, y + 3, x + 1, y + 1), 0);
+  ASSERT_GT(orient2d_exact(x, y, x + 3, y + 3, x + 1, y + 1 + ulp), 0);
+  ASSERT_LT(orient2d_exact(x, y, x + 3, y + 3, x + 1, y + 1 - ulp), 0);
+}
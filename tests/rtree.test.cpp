@@ -0,0 +1,114 @@
+#include "rtree.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "geometry.hpp"
+
+using namespace dsas;
+
+// shorelines of random walks, mixing short and long segments
+static std::vector<std::unique_ptr<Shoreline>> make_shorelines(
+    int num_shorelines, int num_vertices) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> start(0, 1000);
+  std::uniform_real_distribution<double> step(-1, 1);
+  std::vector<std::unique_ptr<Shoreline>> shorelines;
+  for (int s = 0; s < num_shorelines; ++s) {
+    const double scale = s % 2 == 0 ? 0.5 : 200;
+    std::vector<Point> pts;
+    Point p{start(rng), start(rng)};
+    for (int v = 0; v < num_vertices; ++v) {
+      pts.push_back(p);
+      p = Point(p.x + scale * step(rng), p.y + scale * step(rng));
+    }
+    shorelines.push_back(
+        std::make_unique<Shoreline>(std::move(pts), s, Date{2000, 1, 1}));
+  }
+  return shorelines;
+}
+
+TEST(RTreeTest, test_build_empty) {
+  std::vector<std::unique_ptr<Shoreline>> shorelines;
+  shorelines.push_back(
+      std::make_unique<Shoreline>(std::vector<Point>{{0, 0}}, 0, Date{}));
+  auto rtree = build_shoreline_rtree(shorelines);
+  ASSERT_TRUE(rtree.empty());
+  ASSERT_TRUE(rtree.nodes.empty());
+
+  int visited = 0;
+  rtree.query(Point(-1, -1), Point(1, 1), [&](SegRef) { visited++; });
+  ASSERT_EQ(visited, 0);
+}
+
+TEST(RTreeTest, test_build_stores_each_segment_once) {
+  auto shorelines = make_shorelines(7, 300);
+  auto rtree = build_shoreline_rtree(shorelines);
+
+  ASSERT_EQ(rtree.segs.size(), 7 * 299);
+  std::set<std::uint32_t> ids;
+  for (auto seg : rtree.segs) ids.insert(rtree.segment_id(seg));
+  ASSERT_EQ(ids.size(), rtree.segs.size());
+
+  // the leaves partition segs and every node bounds its children
+  size_t covered = 0;
+  for (size_t id = 0; id < rtree.nodes.size(); ++id) {
+    const auto &node = rtree.nodes[id];
+    ASSERT_GT(node.count, 0u);
+    ASSERT_LE(node.count, RTree::node_capacity);
+    for (std::uint32_t k = node.first; k < node.first + node.count; ++k) {
+      double min_x, min_y, max_x, max_y;
+      if (rtree.is_leaf(id)) {
+        const auto &a = rtree.start(rtree.segs[k]);
+        const auto &b = rtree.end(rtree.segs[k]);
+        min_x = std::min(a.x, b.x), max_x = std::max(a.x, b.x);
+        min_y = std::min(a.y, b.y), max_y = std::max(a.y, b.y);
+      } else {
+        ASSERT_LT(k, id);
+        const auto &child = rtree.nodes[k];
+        min_x = child.min_x, max_x = child.max_x;
+        min_y = child.min_y, max_y = child.max_y;
+      }
+      ASSERT_LE(node.min_x, min_x);
+      ASSERT_LE(node.min_y, min_y);
+      ASSERT_GE(node.max_x, max_x);
+      ASSERT_GE(node.max_y, max_y);
+    }
+    if (rtree.is_leaf(id)) covered += node.count;
+  }
+  ASSERT_EQ(covered, rtree.segs.size());
+}
+
+TEST(RTreeTest, test_query_finds_every_crossing_segment) {
+  auto shorelines = make_shorelines(9, 200);
+  auto rtree = build_shoreline_rtree(shorelines);
+
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> coord(-100, 1100);
+  for (int q = 0; q < 50; ++q) {
+    const Point a(coord(rng), coord(rng));
+    const Point b(coord(rng), coord(rng));
+    const LineSegment query(a, b);
+
+    std::set<std::uint32_t> candidates;
+    rtree.query(a, b, [&](SegRef seg) {
+      // no segment is reported twice
+      ASSERT_TRUE(candidates.insert(rtree.segment_id(seg)).second);
+    });
+
+    for (std::uint32_t s = 0; s < shorelines.size(); ++s) {
+      const auto &pts = shorelines[s]->shoreline_vertices_;
+      for (std::uint32_t v = 0; v + 1 < pts.size(); ++v) {
+        if (query.is_intersect(pts[v], pts[v + 1])) {
+          ASSERT_TRUE(candidates.count(rtree.segment_id(SegRef{s, v})));
+        }
+      }
+    }
+  }
+}
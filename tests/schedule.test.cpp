@@ -0,0 +1,58 @@
+#include "schedule.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <vector>
+
+using namespace dsas;
+
+TEST(ScheduleTest, test_order_by_cost) {
+  const std::vector<double> costs{1, 100, 0, 3, 1000, 2.5, 0.5, 120};
+  const auto order = order_by_cost(costs);
+  // decreasing powers of two; 100 and 120 share [64, 128), 2.5 and 3 [2, 4)
+  // and 0 and 0.5 the bucket below 1, each in index order
+  ASSERT_EQ(order, (std::vector<std::uint32_t>{4, 1, 7, 3, 5, 0, 2, 6}));
+  ASSERT_TRUE(order_by_cost({}).empty());
+}
+
+TEST(ScheduleTest, test_for_each_balanced) {
+  const size_t n = 1000;
+  std::vector<std::atomic<int>> visits(n);
+  LoopBalance balance;
+  for_each_balanced(
+      n, [](size_t i) { return static_cast<double>(i % 17); },
+      [&](size_t i, int thread) {
+        ASSERT_GE(thread, 0);
+        ASSERT_LT(thread, static_cast<int>(balance.busy_seconds.size()));
+        ++visits[i];
+      },
+      &balance);
+  for (const auto &count : visits) ASSERT_EQ(count, 1);
+  ASSERT_FALSE(balance.busy_seconds.empty());
+  ASSERT_GE(balance.max_seconds(), balance.mean_seconds());
+  ASSERT_GE(balance.idle_share(), 0);
+  ASSERT_LE(balance.idle_share(), 1);
+
+  // without a balance nothing is timed
+  for_each_balanced(
+      n, [](size_t) { return 1.0; }, [&](size_t i, int) { ++visits[i]; });
+  for (const auto &count : visits) ASSERT_EQ(count, 2);
+}
+
+TEST(ScheduleTest, test_loop_balance) {
+  LoopBalance balance{{1.0, 3.0, 2.0, 2.0}};
+  EXPECT_DOUBLE_EQ(balance.max_seconds(), 3.0);
+  EXPECT_DOUBLE_EQ(balance.mean_seconds(), 2.0);
+  EXPECT_DOUBLE_EQ(balance.idle_share(), 1.0 / 3);
+  EXPECT_EQ(LoopBalance{}.idle_share(), 0);
+
+  ThreadStats stats;
+  stats.intersects = balance;
+  std::ostringstream os;
+  os << stats;
+  EXPECT_NE(os.str().find("generate_intersects: 4 threads"), std::string::npos);
+  EXPECT_EQ(os.str().find("build_transect_index"), std::string::npos);
+}
@@ -0,0 +1,187 @@
+#include "segment_batch.hpp"
+
+#include <gtest/gtest.h>
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "diagnostics.hpp"
+#include "geometry.hpp"
+#include "utility.hpp"
+
+using namespace dsas;
+
+constexpr double TOL = 1e-6;
+
+static std::vector<BatchKernel> supported_kernels() {
+  std::vector<BatchKernel> kernels;
+  for (auto kernel : {BatchKernel::Scalar, BatchKernel::Avx2,
+                      BatchKernel::Avx512, BatchKernel::Neon}) {
+    if (batch_kernel_supported(kernel)) kernels.push_back(kernel);
+  }
+  return kernels;
+}
+
+// Checks every lane of the batch against the pairwise reference: the hit bit
+// against isTwoSegmentIntersected, the point against computeIntersectPoint or,
+// where that fails, the middle of the overlap with the transect.
+static void expect_matches_pairwise(BatchKernel kernel, const Point &start,
+                                    const Point &end,
+                                    const SegmentBatch &batch) {
+  BatchHits hits;
+  intersect_batch(kernel, start, end, batch, hits);
+  for (size_t k = 0; k < SegmentBatch::capacity; k++) {
+    const bool hit = (hits.mask >> k) & 1;
+    if (k >= batch.size) {
+      ASSERT_FALSE(hit) << batch_kernel_name(kernel) << " lane " << k;
+      continue;
+    }
+    const Point p(batch.x0[k], batch.y0[k]);
+    const Point q(batch.x1[k], batch.y1[k]);
+    ASSERT_EQ(hit, isTwoSegmentIntersected(start, end, p, q))
+        << batch_kernel_name(kernel) << " lane " << k;
+    if (!hit) continue;
+
+    Point expected;
+    if (!computeIntersectPoint(start, end, p, q, expected)) {
+      expected = point_along(
+          start, end,
+          overlap_midpoint(TransectConstants(start, end), p.x, p.y, q.x, q.y));
+    }
+    const auto point = point_along(start, end, hits.t[k]);
+    ASSERT_NEAR(point.x, expected.x, TOL) << batch_kernel_name(kernel);
+    ASSERT_NEAR(point.y, expected.y, TOL) << batch_kernel_name(kernel);
+  }
+}
+
+TEST(SegmentBatchTest, test_default_kernel_supported) {
+  ASSERT_TRUE(batch_kernel_supported(default_batch_kernel()));
+  ASSERT_TRUE(batch_kernel_supported(BatchKernel::Scalar));
+}
+
+TEST(SegmentBatchTest, test_random_segments) {
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> coord(0, 100);
+  const Point start(10, 20), end(90, 70);
+  for (auto kernel : supported_kernels()) {
+    for (size_t size : {0, 1, 3, 5, 17, 63, 64}) {
+      SegmentBatch batch;
+      for (size_t k = 0; k < size; k++) {
+        batch.push(Point(coord(rng), coord(rng)),
+                   Point(coord(rng), coord(rng)));
+      }
+      expect_matches_pairwise(kernel, start, end, batch);
+    }
+  }
+}
+
+TEST(SegmentBatchTest, test_edge_cases) {
+  const Point start(0, 0), end(10, 0);
+  SegmentBatch batch;
+  batch.push(Point(5, -5), Point(5, 5));    // plain crossing
+  batch.push(Point(10, 0), Point(10, 5));   // touches the transect end
+  batch.push(Point(3, 0), Point(3, 4));     // starts on the transect
+  batch.push(Point(2, 0), Point(6, 0));     // collinear overlap
+  batch.push(Point(12, 0), Point(15, 0));   // collinear, disjoint
+  batch.push(Point(0, 1), Point(10, 1));    // parallel
+  batch.push(Point(-1, -1), Point(-1, 1));  // outside the box
+  batch.push(Point(5, 5), Point(5, 5));     // degenerate point
+  batch.push(Point(8, 0), Point(20, 0));    // collinear, past the end
+  for (auto kernel : supported_kernels()) {
+    expect_matches_pairwise(kernel, start, end, batch);
+
+    BatchHits hits;
+    intersect_batch(kernel, start, end, batch, hits);
+    ASSERT_EQ(hits.mask, std::uint64_t{0b100001111})
+        << batch_kernel_name(kernel);
+    ASSERT_NEAR(hits.t[0], 0.5, TOL);
+    ASSERT_NEAR(hits.t[1], 1.0, TOL);
+    ASSERT_NEAR(hits.t[3], 0.4, TOL);  // middle of the overlap [2, 6]
+    ASSERT_NEAR(hits.t[8], 0.9, TOL);  // middle of the overlap [8, 10]
+  }
+}
+
+TEST(SegmentBatchTest, test_stale_lanes_masked) {
+  // lanes beyond size still hold crossing segments from an earlier fill
+  SegmentBatch batch;
+  for (size_t k = 0; k < SegmentBatch::capacity; k++) {
+    batch.push(Point(k + 0.5, -1), Point(k + 0.5, 1));
+  }
+  batch.clear();
+  batch.push(Point(1.5, -1), Point(1.5, 1));
+  batch.push(Point(2.5, 1), Point(2.5, 2));
+  for (auto kernel : supported_kernels()) {
+    BatchHits hits;
+    intersect_batch(kernel, Point(0, 0), Point(64, 0), batch, hits);
+    ASSERT_EQ(hits.mask, std::uint64_t{1}) << batch_kernel_name(kernel);
+  }
+}
+
+TEST(SegmentBatchTest, test_near_collinear_segments) {
+  // segments starting on (the rounded points of) the transect, where plain
+  // floating-point orientations cannot be trusted; every kernel must follow
+  // the exact predicates of isTwoSegmentIntersected
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<double> unit(0, 1);
+  std::uniform_real_distribution<double> coord(-50, 150);
+  const Point start(0.1, 0.3), end(97.3, 41.9);
+  diagnostics.reset();
+  for (auto kernel : supported_kernels()) {
+    for (int round = 0; round < 20; round++) {
+      SegmentBatch batch;
+      while (!batch.full()) {
+        const auto on_line = point_along(start, end, unit(rng));
+        const auto other = batch.size % 3 == 0
+                               ? point_along(start, end, 2 * unit(rng) - 0.5)
+                               : Point(coord(rng), coord(rng));
+        batch.push(on_line, other);
+      }
+      expect_matches_pairwise(kernel, start, end, batch);
+    }
+  }
+  ASSERT_GT(diagnostics.exact_orientations, 0);
+  diagnostics.reset();
+}
+
+TEST(SegmentBatchTest, test_kernels_agree_on_underflow_and_nan) {
+  // orientations around 1e-180 whose products underflow to zero, and
+  // NaN or infinite coordinates: every kernel must give the scalar's lanes
+  const double u = 1e-90;
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  const double inf = std::numeric_limits<double>::infinity();
+  const Point start(0, 0), end(4 * u, 4 * u);
+  SegmentBatch batch;
+  batch.push(Point(u, 2 * u), Point(2 * u, 3.5 * u));  // above, no crossing
+  batch.push(Point(u, 3 * u), Point(3 * u, u));        // crossing
+  batch.push(Point(2 * u, 2.5 * u), Point(3 * u, 2 * u));
+  const double specials[] = {nan, inf, -inf, u};
+  for (double a : specials) {
+    for (double b : specials) {
+      batch.push(Point(a, u), Point(2 * u, b));
+      batch.push(Point(u, a), Point(b, 2 * u));
+    }
+  }
+  batch.push(Point(0, 0), Point(inf, inf));
+
+  BatchHits expected;
+  intersect_batch(BatchKernel::Scalar, start, end, batch, expected);
+  ASSERT_EQ(expected.mask & 0b111, std::uint64_t{0b110});
+  for (auto kernel : supported_kernels()) {
+    BatchHits hits;
+    intersect_batch(kernel, start, end, batch, hits);
+    ASSERT_EQ(hits.mask, expected.mask) << batch_kernel_name(kernel);
+    for (auto mask = hits.mask; mask != 0; mask &= mask - 1) {
+      const auto k = static_cast<size_t>(std::countr_zero(mask));
+      if (std::isnan(expected.t[k])) {
+        EXPECT_TRUE(std::isnan(hits.t[k])) << batch_kernel_name(kernel);
+      } else {
+        EXPECT_NEAR(hits.t[k], expected.t[k], TOL)
+            << batch_kernel_name(kernel) << " lane " << k;
+      }
+    }
+  }
+}
@@ -0,0 +1,340 @@
+#include "shapefile.hpp"
+
+#include <gtest/gtest.h>
+#include <shapefil.h>
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "baseline.hpp"
+#include "options.hpp"
+#include "shoreline.hpp"
+#include "transect.hpp"
+
+using namespace dsas;
+
+namespace {
+// Writes a shapefile byte by byte: .shp, .shx and a .dbf with a
+// 10-character text field ("Date") and a 4-digit numeric field ("Id").
+struct ShapefileWriter {
+  struct Record {
+    int shape_type;
+    std::vector<std::vector<Point>> lines;
+    std::string date;
+    std::string id;
+  };
+  std::vector<Record> records;
+  std::string date_field = "Date";
+  std::string id_field = "Id";
+
+  static void put(std::string &out, const void *value, size_t size,
+                  std::endian order) {
+    std::string bytes(static_cast<const char *>(value), size);
+    if (order != std::endian::native) std::reverse(bytes.begin(), bytes.end());
+    out += bytes;
+  }
+  static void be32(std::string &out, std::int32_t v) {
+    put(out, &v, 4, std::endian::big);
+  }
+  static void le32(std::string &out, std::int32_t v) {
+    put(out, &v, 4, std::endian::little);
+  }
+  static void le64f(std::string &out, double v) {
+    put(out, &v, 8, std::endian::little);
+  }
+  static std::string main_header(size_t file_size) {
+    std::string h;
+    be32(h, 9994);
+    h.append(20, '\0');
+    be32(h, static_cast<std::int32_t>(file_size / 2));
+    le32(h, 1000);
+    le32(h, SHPT_ARC);
+    h.append(64, '\0');
+    return h;
+  }
+  static std::string pad(const std::string &value, size_t width) {
+    return std::string(width - value.size(), ' ') + value;
+  }
+
+  void write(const std::filesystem::path &shp_path) const {
+    std::string shp_records, shx_records;
+    for (size_t i = 0; i < records.size(); ++i) {
+      const auto &r = records[i];
+      std::string content;
+      le32(content, r.shape_type);
+      size_t num_points = 0;
+      for (const auto &line : r.lines) num_points += line.size();
+      if (r.shape_type == SHPT_POINT) {
+        le64f(content, r.lines[0][0].x);
+        le64f(content, r.lines[0][0].y);
+      } else if (r.shape_type == SHPT_MULTIPOINT) {
+        content.append(32, '\0');  // bounding box
+        le32(content, static_cast<std::int32_t>(num_points));
+        for (const auto &line : r.lines) {
+          for (const auto &p : line) {
+            le64f(content, p.x);
+            le64f(content, p.y);
+          }
+        }
+      } else if (r.shape_type == SHPT_ARC || r.shape_type == SHPT_ARCZ ||
+                 r.shape_type == SHPT_POLYGON) {
+        content.append(32, '\0');  // bounding box, unused by the reader
+        le32(content, static_cast<std::int32_t>(r.lines.size()));
+        le32(content, static_cast<std::int32_t>(num_points));
+        size_t first = 0;
+        for (const auto &line : r.lines) {
+          le32(content, static_cast<std::int32_t>(first));
+          first += line.size();
+        }
+        for (const auto &line : r.lines) {
+          for (const auto &p : line) {
+            le64f(content, p.x);
+            le64f(content, p.y);
+          }
+        }
+        if (r.shape_type == SHPT_ARCZ) {  // z range and values, skipped
+          for (size_t k = 0; k < num_points + 2; ++k) le64f(content, 99);
+        }
+      }
+      be32(shx_records, static_cast<std::int32_t>(
+                            (100 + shp_records.size()) / 2));
+      be32(shx_records, static_cast<std::int32_t>(content.size() / 2));
+      be32(shp_records, static_cast<std::int32_t>(i + 1));
+      be32(shp_records, static_cast<std::int32_t>(content.size() / 2));
+      shp_records += content;
+    }
+
+    auto path = shp_path;
+    std::ofstream(path, std::ios::binary)
+        << main_header(100 + shp_records.size()) << shp_records;
+    path.replace_extension(".shx");
+    std::ofstream(path, std::ios::binary)
+        << main_header(100 + shx_records.size()) << shx_records;
+
+    std::string dbf(32, '\0');
+    dbf[0] = 3;
+    const auto num_records = static_cast<std::int32_t>(records.size());
+    std::memcpy(&dbf[4], &num_records, 4);  // tests run little-endian
+    const int header_size = 32 + 2 * 32 + 1, record_size = 1 + 10 + 4;
+    dbf[8] = static_cast<char>(header_size);
+    dbf[10] = static_cast<char>(record_size);
+    auto field = [&](const char *name, char type, int width) {
+      std::string f(32, '\0');
+      std::memcpy(&f[0], name, std::strlen(name));
+      f[11] = type;
+      f[16] = static_cast<char>(width);
+      dbf += f;
+    };
+    field(date_field.c_str(), 'C', 10);
+    field(id_field.c_str(), 'N', 4);
+    dbf += '\x0D';
+    for (const auto &r : records) {
+      dbf += ' ' + r.date + std::string(10 - r.date.size(), ' ') +
+             pad(r.id, 4);
+    }
+    path.replace_extension(".dbf");
+    std::ofstream(path, std::ios::binary) << dbf;
+  }
+};
+
+ShapefileWriter sample() {
+  ShapefileWriter writer;
+  writer.records = {
+      {SHPT_ARC, {{{0, 0}, {1, 1}, {2, 0.5}}}, "2000/01/01", "7"},
+      {SHPT_NULL, {}, "2001/01/01", ""},
+      {SHPT_ARCZ,
+       {{{10, 10}, {11, 12}}, {{20, 20}, {21, 19}, {22, 22}}},
+       "2002/06/15",
+       "12"},
+  };
+  return writer;
+}
+}  // namespace
+
+TEST(ShapefileTest, test_read_records) {
+  const auto path = std::filesystem::temp_directory_path() / "read.shp";
+  sample().write(path);
+
+  ShapefileReader shapefile(path);
+  ASSERT_EQ(shapefile.size(), 3);
+
+  ShapeRecord record;
+  shapefile.read(0, record);
+  EXPECT_EQ(record.shape_type, SHPT_ARC);
+  ASSERT_EQ(record.num_parts(), 1);
+  ASSERT_EQ(record.points.size(), 3);
+  EXPECT_EQ(record.points[2].x, 2);
+  EXPECT_EQ(record.points[2].y, 0.5);
+
+  shapefile.read(1, record);
+  EXPECT_EQ(record.shape_type, SHPT_NULL);
+  EXPECT_TRUE(record.points.empty());
+
+  shapefile.read(2, record);
+  EXPECT_EQ(record.shape_type, SHPT_ARCZ);
+  ASSERT_EQ(record.num_parts(), 2);
+  ASSERT_EQ(record.part(0).size(), 2);
+  ASSERT_EQ(record.part(1).size(), 3);
+  EXPECT_EQ(record.part(1)[1].x, 21);
+  EXPECT_EQ(record.part(1)[1].y, 19);
+  ASSERT_THROW(shapefile.read(3, record), std::runtime_error);
+
+  EXPECT_EQ(shapefile.field_index("date"), 0);
+  EXPECT_EQ(shapefile.field_index("ID"), 1);
+  EXPECT_EQ(shapefile.field_index("Missing"), -1);
+  EXPECT_EQ(shapefile.string_attribute(0, 0), "2000/01/01");
+  EXPECT_EQ(shapefile.string_attribute(2, 1), "12");
+  EXPECT_EQ(shapefile.integer_attribute(2, 1), 12);
+  EXPECT_EQ(shapefile.integer_attribute(1, 1), 0);
+}
+
+TEST(ShapefileTest, test_load_from_shapefile) {
+  const auto path = std::filesystem::temp_directory_path() / "load.shp";
+  sample().write(path);
+
+  options.date_format = "%Y/%m/%d";
+  const auto shorelines = load_shorelines_shp(path, "DATE");
+  ASSERT_EQ(shorelines.size(), 3);
+  EXPECT_EQ(shorelines[0]->shoreline_id_, 0);
+  EXPECT_EQ(shorelines[1]->shoreline_id_, 2);
+  EXPECT_EQ(shorelines[2]->shoreline_id_, 2);
+  EXPECT_EQ(shorelines[2]->date_.month(), 6);
+  EXPECT_EQ(shorelines[2]->shoreline_vertices_.size(), 3);
+  ASSERT_THROW(load_shorelines_shp(path, "Missing"), std::runtime_error);
+
+  const auto baselines = load_baselines_shp(path, "Id");
+  ASSERT_EQ(baselines.size(), 3);
+  EXPECT_EQ(baselines[0].baseline_id_, 7);
+  EXPECT_EQ(baselines[2].baseline_id_, 12);
+
+  auto shx = path;
+  shx.replace_extension(".shx");
+  std::filesystem::remove(shx);
+  ASSERT_THROW(ShapefileReader{path}, std::runtime_error);
+}
+
+TEST(ShapefileTest, test_read_records_in_order) {
+  ShapefileWriter writer;
+  const size_t n = 1000;
+  for (size_t i = 0; i < n; ++i) {
+    const double x = static_cast<double>(i);
+    // every third record has two lines, some none, so the ranges differ
+    std::vector<std::vector<Point>> lines{{{x, 0}, {x, 1}}};
+    if (i % 3 == 0) lines.push_back({{x, 2}, {x, 3}, {x, 4}});
+    writer.records.push_back({i % 7 == 0 ? SHPT_NULL : SHPT_ARC, lines,
+                              "2000/01/01", std::to_string(i)});
+  }
+  const auto path = std::filesystem::temp_directory_path() / "order.shp";
+  writer.write(path);
+
+  options.date_format = "%Y/%m/%d";
+  const auto shorelines = load_shorelines_shp(path, "Date");
+  size_t k = 0;
+  for (size_t i = 0; i < n; ++i) {
+    if (i % 7 == 0) continue;
+    for (size_t line = 0; line < (i % 3 == 0 ? 2 : 1); ++line, ++k) {
+      ASSERT_LT(k, shorelines.size());
+      EXPECT_EQ(shorelines[k]->shoreline_id_, static_cast<int>(i));
+      EXPECT_EQ(shorelines[k]->shoreline_vertices_.size(), 2 + line);
+      EXPECT_EQ(shorelines[k]->shoreline_vertices_[0].x,
+                static_cast<double>(i));
+    }
+  }
+  EXPECT_EQ(k, shorelines.size());
+
+  // the lowest failing record's error is the one reported
+  writer.records[900].date = "bad 900";
+  writer.records[500].date = "bad 500";
+  writer.write(path);
+  try {
+    load_shorelines_shp(path, "Date");
+    FAIL() << "expected a date error";
+  } catch (const std::runtime_error &e) {
+    EXPECT_NE(std::string(e.what()).find("bad 500"), std::string::npos);
+  }
+}
+
+TEST(ShapefileTest, test_read_other_shape_types) {
+  // polygons, multipoints and points keep their vertices as with shapelib
+  ShapefileWriter writer;
+  writer.records = {
+      {SHPT_POLYGON, {{{0, 0}, {4, 0}, {4, 3}, {0, 0}}}, "2000/01/01", "1"},
+      {SHPT_MULTIPOINT, {{{5, 5}, {6, 7}, {8, 9}}}, "2000/01/01", "2"},
+      {SHPT_POINT, {{{3, 4}}}, "2000/01/01", "3"},
+  };
+  const auto path = std::filesystem::temp_directory_path() / "types.shp";
+  writer.write(path);
+
+  ShapefileReader shapefile(path);
+  ShapeRecord record;
+  shapefile.read(0, record);
+  EXPECT_EQ(record.shape_type, SHPT_POLYGON);
+  ASSERT_EQ(record.num_parts(), 1);
+  ASSERT_EQ(record.points.size(), 4);
+  EXPECT_EQ(record.points[2].x, 4);
+  EXPECT_EQ(record.points[2].y, 3);
+
+  shapefile.read(1, record);
+  EXPECT_EQ(record.shape_type, SHPT_MULTIPOINT);
+  EXPECT_EQ(record.num_parts(), 0);
+  ASSERT_EQ(record.points.size(), 3);
+  EXPECT_EQ(record.points[1].x, 6);
+  EXPECT_EQ(record.points[1].y, 7);
+
+  shapefile.read(2, record);
+  EXPECT_EQ(record.shape_type, SHPT_POINT);
+  EXPECT_EQ(record.num_parts(), 0);
+  ASSERT_EQ(record.points.size(), 1);
+  EXPECT_EQ(record.points[0].x, 3);
+  EXPECT_EQ(record.points[0].y, 4);
+
+  // shorelines are polylines only
+  options.date_format = "%Y/%m/%d";
+  EXPECT_TRUE(load_shorelines_shp(path, "Date").empty());
+
+  // a shape type the format does not define
+  writer.records[1].shape_type = 99;
+  writer.write(path);
+  ShapefileReader unsupported(path);
+  try {
+    unsupported.read(1, record);
+    FAIL() << "expected an unsupported shape type error";
+  } catch (const std::runtime_error &e) {
+    EXPECT_NE(std::string(e.what()).find("Unsupported shape type 99"),
+              std::string::npos);
+  }
+}
+
+TEST(ShapefileTest, test_load_transects_of_any_shape_type) {
+  // a transect runs from the first to the last vertex, whatever the shape
+  ShapefileWriter writer;
+  writer.date_field = "TransectId";
+  writer.id_field = "BaselineId";
+  writer.records = {
+      {SHPT_ARC, {{{0, 0}, {1, 1}, {0, 10}}}, "5", "1"},
+      {SHPT_POLYGON, {{{2, 0}, {3, 5}, {2, 10}}}, "6", "1"},
+      {SHPT_MULTIPOINT, {{{4, 0}, {4, 10}}}, "7", "2"},
+      {SHPT_POINT, {{{6, 0}}}, "8", "2"},  // a single vertex: skipped
+  };
+  const auto path = std::filesystem::temp_directory_path() / "transects.shp";
+  writer.write(path);
+
+  const auto saved = options;
+  options.intersection_mode = Options::IntersectionMode::Closest;
+  options.transect_orient = Options::TransectOrientation::Left;
+  const auto transects = load_transects_from_shp(path);
+  options = saved;
+  ASSERT_EQ(transects.size(), 3);
+  for (size_t i = 0; i < transects.size(); i++) {
+    const auto &line = writer.records[i].lines[0];
+    EXPECT_EQ(transects[i].transect_id(), static_cast<int>(5 + i));
+    EXPECT_EQ(transects[i].left_edge(), line.front());
+    EXPECT_EQ(transects[i].right_edge(), line.back());
+  }
+  EXPECT_EQ(transects.baseline_id[2], 2);
+}
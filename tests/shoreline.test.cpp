@@ -2,8 +2,10 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <fstream>
 #include <stdexcept>
+#include <vector>
 using namespace dsas;
 #define TOL 1e-4
 
@@ -13,6 +15,13 @@ TEST(TestShoreline, test_load_shorelines_shp) {
   // Normal load (case-insensitive field match: "date" → "Date")
   auto ret = load_shorelines_shp(shoreline_shp_path, "date");
   ASSERT_TRUE(!ret.empty());
+  for (const auto &shoreline : ret) ASSERT_TRUE(shoreline->has_envelopes());
+
+  // Projection read in the same pass
+  std::string prj;
+  ASSERT_EQ(load_shorelines_shp(shoreline_shp_path, "date", &prj).size(),
+            ret.size());
+  ASSERT_EQ(prj, "EPSG:32617");
 
   // Wrong date field name — should throw (date field not found)
   ASSERT_THROW(load_shorelines_shp(shoreline_shp_path, "WrongField"),
@@ -115,4 +124,69 @@ TEST(TestShoreline, test_generate_date_from_str) {
     options.date_format = "%y-%m-%d";
     ASSERT_THROW(generate_date_from_str(date_str), std::runtime_error);
   }
-}
\ No newline at end of file
+}
+TEST(TestShoreline, test_date_parser) {
+  // hand-parsed formats, and ones left to strptime
+  struct Case {
+    const char *format, *text;
+    int year, month, day;
+  };
+  const std::vector<Case> cases{
+      {"%Y/%m/%d", "2020/01/15", 2020, 1, 15},
+      {"%Y-%m-%d", "2020-1-5", 2020, 1, 5},
+      {"%m/%d/%Y", "01/15/2020", 2020, 1, 15},
+      {"%Y%m%d", "20200115", 2020, 1, 15},
+      {"%d.%b.%Y", "15.Jan.2020", 2020, 1, 15},
+      {"%Y/%m/%d", " 2020/01/15", 2020, 1, 15}};
+  for (const auto &c : cases) {
+    DateParser parser(c.format);
+    EXPECT_EQ(parser.format(), c.format);
+    for (int repeat = 0; repeat < 2; ++repeat) {  // parsed, then cached
+      const auto date = parser.parse(c.text);
+      EXPECT_EQ(date.year(), c.year) << c.format << " " << c.text;
+      EXPECT_EQ(date.month(), c.month) << c.format << " " << c.text;
+      EXPECT_EQ(date.day(), c.day) << c.format << " " << c.text;
+    }
+  }
+
+  DateParser parser("%Y/%m/%d");
+  const auto date = parser.parse("2020/02/29");
+  EXPECT_EQ(date.julian_day(), (Date{2020, 2, 29}.julian_day()));
+  EXPECT_EQ(parser.parse("1999/12/31").year(), 1999);
+  EXPECT_EQ(parser.parse("2020/02/29").month(), 2);
+  for (const char *bad : {"", "2020/13/01", "2020/01/32", "2020/01/15x",
+                          "02020/01/15", "2020-01-15"}) {
+    ASSERT_THROW(parser.parse(bad), std::runtime_error) << bad;
+  }
+}
+
+TEST(TestShoreline, test_envelopes) {
+  // 70 segments: chunks of 32, 32 and 6
+  std::vector<Point> vertices;
+  for (int i = 0; i <= 70; ++i) vertices.emplace_back(i, i % 2 ? -i : i);
+  Shoreline shoreline(vertices, 0, Date{2000, 1, 1});
+  ASSERT_TRUE(shoreline.has_envelopes());
+  ASSERT_EQ(shoreline.chunk_envelopes_.size(), 3);
+
+  for (size_t c = 0; c < 3; ++c) {
+    const auto &chunk = shoreline.chunk_envelopes_[c];
+    // the chunk shares its last vertex with the next chunk
+    ASSERT_EQ(chunk.min_x, 32.0 * c);
+    ASSERT_EQ(chunk.max_x, std::min(70.0, 32.0 * c + 32));
+  }
+  ASSERT_EQ(shoreline.envelope_.min_x, 0);
+  ASSERT_EQ(shoreline.envelope_.max_x, 70);
+  ASSERT_EQ(shoreline.envelope_.min_y, -69);
+  ASSERT_EQ(shoreline.envelope_.max_y, 70);
+
+  // vertices added after construction leave the envelopes stale until
+  // they are computed again
+  Shoreline filled;
+  filled.shoreline_vertices_ = vertices;
+  ASSERT_FALSE(filled.has_envelopes());
+  filled.compute_envelopes();
+  ASSERT_TRUE(filled.has_envelopes());
+
+  ASSERT_TRUE(Shoreline().has_envelopes());
+  ASSERT_FALSE(Envelope{}.intersects(shoreline.envelope_));
+}
@@ -2,12 +2,16 @@
 
 #include <gtest/gtest.h>
 
+#include <cmath>
 #include <filesystem>
 #include <limits>
+#include <random>
 #include <stdexcept>
+#include <utility>
 
 #include "grid.hpp"
 #include "options.hpp"
+#include "rtree.hpp"
 #include "utility.hpp"
 using namespace dsas;
 constexpr double TOL = 1e-4;
@@ -44,8 +48,8 @@ TEST_F(TransectTest, test_baseline_transect_lines) {
   double y[]{0, 0.5, 1, 0.5, 0.5, 0.5, 0};
 
   for (size_t i = 0; i < transects_lines.size(); i++) {
-    ASSERT_NEAR(x[i], transects_lines[i]->transect_ref_point_.x, TOL);
-    ASSERT_NEAR(y[i], transects_lines[i]->transect_ref_point_.y, TOL);
+    ASSERT_NEAR(x[i], transects_lines[i].ref_point().x, TOL);
+    ASSERT_NEAR(y[i], transects_lines[i].ref_point().y, TOL);
   }
 }
 
@@ -68,10 +72,10 @@ TEST_F(TransectTest, test_baseline_transect_lines_right) {
   double x_left[]{0, 0, 0, 0.5, 1, 1, 1};
   double y_left[]{0, 0.5, 1, 1, 1, 0.5, 0};
   for (size_t i = 0; i < transects_lines.size(); i++) {
-    ASSERT_NEAR(x_right[i], transects_lines[i]->rightEdge_.x, TOL);
-    ASSERT_NEAR(y_right[i], transects_lines[i]->rightEdge_.y, TOL);
-    ASSERT_NEAR(x_left[i], transects_lines[i]->leftEdge_.x, TOL);
-    ASSERT_NEAR(y_left[i], transects_lines[i]->leftEdge_.y, TOL);
+    ASSERT_NEAR(x_right[i], transects_lines[i].right_edge().x, TOL);
+    ASSERT_NEAR(y_right[i], transects_lines[i].right_edge().y, TOL);
+    ASSERT_NEAR(x_left[i], transects_lines[i].left_edge().x, TOL);
+    ASSERT_NEAR(y_left[i], transects_lines[i].left_edge().y, TOL);
   }
 }
 
@@ -95,10 +99,10 @@ TEST_F(TransectTest, test_baseline_transect_lines_mix) {
   double x_left[]{-0.5, -0.5, -0.5, 0.5, 1, 1.5, 1.5};
   double y_left[]{0, 0.5, 1, 1.5, 1.5, 0.5, 0};
   for (size_t i = 0; i < transects_lines.size(); i++) {
-    ASSERT_NEAR(x_right[i], transects_lines[i]->rightEdge_.x, TOL);
-    ASSERT_NEAR(y_right[i], transects_lines[i]->rightEdge_.y, TOL);
-    ASSERT_NEAR(x_left[i], transects_lines[i]->leftEdge_.x, TOL);
-    ASSERT_NEAR(y_left[i], transects_lines[i]->leftEdge_.y, TOL);
+    ASSERT_NEAR(x_right[i], transects_lines[i].right_edge().x, TOL);
+    ASSERT_NEAR(y_right[i], transects_lines[i].right_edge().y, TOL);
+    ASSERT_NEAR(x_left[i], transects_lines[i].left_edge().x, TOL);
+    ASSERT_NEAR(y_left[i], transects_lines[i].left_edge().y, TOL);
   }
 }
 
@@ -120,10 +124,10 @@ TEST_F(TransectTest, test_baseline_transect_lines_left) {
   double y_right[]{0, 0.5, 1, 1, 1, 0.5, 0};
 
   for (size_t i = 0; i < transects_lines.size(); i++) {
-    ASSERT_NEAR(x_right[i], transects_lines[i]->rightEdge_.x, TOL);
-    ASSERT_NEAR(y_right[i], transects_lines[i]->rightEdge_.y, TOL);
-    ASSERT_NEAR(x_left[i], transects_lines[i]->leftEdge_.x, TOL);
-    ASSERT_NEAR(y_left[i], transects_lines[i]->leftEdge_.y, TOL);
+    ASSERT_NEAR(x_right[i], transects_lines[i].right_edge().x, TOL);
+    ASSERT_NEAR(y_right[i], transects_lines[i].right_edge().y, TOL);
+    ASSERT_NEAR(x_left[i], transects_lines[i].left_edge().x, TOL);
+    ASSERT_NEAR(y_left[i], transects_lines[i].left_edge().y, TOL);
   }
 }
 
@@ -135,9 +139,10 @@ TEST_F(TransectTest, test_baseline_transect_length1) {
   options.intersection_mode = dsas::Options::IntersectionMode::Closest;
   baseline = std::make_unique<Baseline>(points, 0);
   auto transects_lines = create_transects_from_baseline(*baseline);
-  for (const auto &transect : transects_lines) {
-    ASSERT_NEAR(transect->leftEdge_.distance_to_point(transect->rightEdge_), 1,
-                TOL);
+  for (size_t i = 0; i < transects_lines.size(); i++) {
+    const auto transect = transects_lines[i];
+    ASSERT_NEAR(transect.left_edge().distance_to_point(transect.right_edge()),
+                1, TOL);
   }
 }
 
@@ -149,9 +154,10 @@ TEST_F(TransectTest, test_baseline_transect_length2) {
   options.intersection_mode = dsas::Options::IntersectionMode::Closest;
   baseline = std::make_unique<Baseline>(points, 0);
   auto transects_lines = create_transects_from_baseline(*baseline);
-  for (const auto &transect : transects_lines) {
-    ASSERT_NEAR(transect->leftEdge_.distance_to_point(transect->rightEdge_), 1,
-                TOL);
+  for (size_t i = 0; i < transects_lines.size(); i++) {
+    const auto transect = transects_lines[i];
+    ASSERT_NEAR(transect.left_edge().distance_to_point(transect.right_edge()),
+                1, TOL);
   }
 }
 
@@ -167,8 +173,10 @@ TEST_F(TransectTest, test_baseline_smooth) {
     baseline = std::make_unique<Baseline>(points, 0);
     auto transects_lines = create_transects_from_baseline(*baseline);
     ASSERT_EQ(baseline->origin_vertices_.size(), 4);
-    double slope{transects_lines[0]->normal_vector_.first /
-                 transects_lines[0]->normal_vector_.second};
+    // slope of the transect's normal, along the baseline
+    const auto left = transects_lines[0].left_edge();
+    const auto right = transects_lines[0].right_edge();
+    double slope{-(right.x - left.x) / (right.y - left.y)};
     ASSERT_NEAR(slope, 1, TOL);
   }
   {
@@ -313,14 +321,46 @@ TEST_F(TransectTest, test_transect_farthest_mode_multiple_intersections) {
   ASSERT_NEAR(result->y, 1.0, TOL);
 }
 
+TEST_F(TransectTest, test_transect_intersection_pruned_chunks) {
+  // a 100-segment shoreline along y = 0 .. 1; transects crossing it inside a
+  // chunk and exactly at the vertex two chunks share
+  std::vector<Point> shore_pts;
+  for (int i = 0; i <= 100; ++i) shore_pts.emplace_back(i, i % 2);
+  Shoreline shore(shore_pts, 0, Date{2000, 1, 1});
+  for (double x : {5.5, 32.0, 64.0, 99.25}) {
+    TransectLine t(Point{x, -5.0}, Point{x, 5.0}, 0, 0);
+    auto result = t.intersection(shore);
+    ASSERT_TRUE(result.has_value()) << x;
+    EXPECT_NEAR(result->x, x, TOL);
+  }
+  // outside of the shoreline's envelope
+  TransectLine t(Point{101.0, -5.0}, Point{101.0, 5.0}, 0, 0);
+  ASSERT_FALSE(t.intersection(shore).has_value());
+}
+
 TEST_F(TransectTest, test_transect_grid_intersection_missing_cell) {
-  // grid_index references a cell not in the Grids map — should be skipped
+  // grid_index references a cell holding no segment — should be skipped
+  const auto bound = make_grid_bound(0, 0, 10, 10, 1);
+  Date d{2000, 1, 1};
+  std::vector<std::unique_ptr<Shoreline>> shorelines;
+  shorelines.push_back(std::make_unique<Shoreline>(
+      std::vector<Point>{{8.5, 8.5}, {9.5, 8.5}}, 0, d));
+  auto grids = build_shoreline_index(shorelines, bound);
+
   Point start{0.0, 0.0}, end{0.0, 1.0};
-  TransectLine t(start, end, 0, 0);
-  t.grid_index.push_back({0, 0});
-  Grid::grid_ny = 10;
-  Grids empty_grids;
-  auto results = t.intersection(empty_grids);
+  TransectTable transects;
+  transects.push_back(TransectLine(start, end, 0, 0));
+  transects.cell_first = {0, 1};
+  transects.cells = {{0, 0}};
+  transects.cells_bound = bound;
+  IntersectTable results;
+  transects[0].intersection(grids, results);
+  ASSERT_TRUE(results.empty());
+
+  // cells outside of the index are skipped as well
+  transects.cell_first = {0, 2};
+  transects.cells.emplace_back(42, 42);
+  transects[0].intersection(grids, results);
   ASSERT_TRUE(results.empty());
 }
 
@@ -333,23 +373,238 @@ TEST_F(TransectTest, test_transect_grid_intersection_collinear_no_crash) {
   // it must now fall back to the segment midpoint instead of crashing.
   Point start{0.0, 0.0}, end{0.0, 10.0};
   TransectLine t(start, end, 0, 0);
-  t.grid_index.push_back({0, 0});
-  Grid::grid_ny = 1;
 
   Date d{2000, 1, 1};
-  auto shoreline = std::make_unique<Shoreline>(
-      std::vector<Point>{{0.0, 3.0}, {0.0, 7.0}}, 0, d);
+  std::vector<std::unique_ptr<Shoreline>> shorelines;
+  shorelines.push_back(std::make_unique<Shoreline>(
+      std::vector<Point>{{0.0, 3.0}, {0.0, 7.0}}, 0, d));
+  const auto bound = make_grid_bound(-1, 0, 1, 10, 2);
+  auto grids = build_shoreline_index(shorelines, bound);
+
+  IntersectTable results;
+  ASSERT_NO_THROW(t.intersection(grids, results));
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_NEAR(results.x[0], 0.0, TOL);
+  EXPECT_NEAR(results.y[0], 5.0, TOL);
+}
 
-  auto grid = std::make_unique<Grid>(0.0, 0.0, 0, 0);
-  grid->shoreline_segs.push_back(
-      ShoreSeg{Point{0.0, 3.0}, Point{0.0, 7.0}, shoreline.get()});
+TEST_F(TransectTest, test_transect_grid_intersection_best_per_shoreline) {
+  // Transect from (0,0) to (0,10); ref point = midpoint (0,5). Shoreline 4
+  // zigzags across it at y = 1, 2, 3 and 4.5, shoreline 2 once at y = 8;
+  // the index queries keep the same hit per shoreline as brute force.
+  Date d{2000, 1, 1};
+  std::vector<std::unique_ptr<Shoreline>> shorelines;
+  shorelines.push_back(std::make_unique<Shoreline>(
+      std::vector<Point>{{-1.0, 1.0}, {1.0, 1.0}, {-1.0, 3.0}, {1.0, 3.0},
+                         {-1.0, 6.0}},
+      4, d));
+  shorelines.push_back(std::make_unique<Shoreline>(
+      std::vector<Point>{{-1.0, 8.0}, {1.0, 8.0}}, 2, d));
+  auto grids =
+      build_shoreline_index(shorelines, make_grid_bound(-1, 0, 1, 10, 1));
+  auto rtree = build_shoreline_rtree(shorelines);
+
+  for (auto [mode, expected_y] :
+       {std::pair{Options::IntersectionMode::Closest, 4.5},
+        std::pair{Options::IntersectionMode::Farthest, 1.0}}) {
+    TransectLine t(Point{0.0, 0.0}, Point{0.0, 10.0}, 0, 0, mode,
+                   Options::TransectOrientation::Mix);
+    const auto brute = t.intersection(*shorelines[0]);
+    ASSERT_TRUE(brute.has_value());
+    EXPECT_NEAR(brute->y, expected_y, TOL);
+
+    IntersectTable results;
+    t.intersection(grids, results);
+    t.intersection(rtree, results);
+    ASSERT_EQ(results.size(), 4);
+    for (size_t i : {0, 2}) {  // shoreline 2 first, by id
+      EXPECT_EQ(results.shoreline_id[i], 2);
+      EXPECT_NEAR(results.y[i], 8.0, TOL);
+      EXPECT_EQ(results.shoreline_id[i + 1], 4);
+      EXPECT_NEAR(results.y[i + 1], expected_y, TOL);
+    }
+  }
+}
 
-  Grids grids;
-  grids[0] = std::move(grid);
+TEST_F(TransectTest, test_transect_grid_intersection_long_segment) {
+  // A shoreline segment spanning many cells is tested once per query, and
+  // repeated queries (against different indices) keep finding it.
+  Date d{2000, 1, 1};
+  std::vector<std::unique_ptr<Shoreline>> shorelines;
+  shorelines.push_back(std::make_unique<Shoreline>(
+      std::vector<Point>{{0.0, 0.0}, {10.0, 10.0}, {10.5, 10.0}}, 7, d));
+  auto fine_grids =
+      build_shoreline_index(shorelines, make_grid_bound(0, 0, 11, 11, 0.5));
+  auto coarse_grids =
+      build_shoreline_index(shorelines, make_grid_bound(0, 0, 11, 11, 5));
+
+  TransectLine t(Point{0.0, 10.0}, Point{10.0, 0.0}, 3, 0);
+  for (const auto *grids : {&fine_grids, &coarse_grids, &fine_grids}) {
+    IntersectTable results;
+    t.intersection(*grids, results);
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results.shoreline_id[0], 7);
+    EXPECT_EQ(results.transect_id[0], 3);
+    EXPECT_NEAR(results.x[0], 5.0, TOL);
+    EXPECT_NEAR(results.y[0], 5.0, TOL);
+  }
+}
 
-  std::vector<std::unique_ptr<IntersectPoint>> results;
-  ASSERT_NO_THROW(results = t.intersection(grids));
+TEST_F(TransectTest, test_transect_grid_intersection_stored_cells_other_grid) {
+  // Cells stored for one grid must not be used to query another one.
+  Date d{2000, 1, 1};
+  std::vector<std::unique_ptr<Shoreline>> shorelines;
+  shorelines.push_back(std::make_unique<Shoreline>(
+      std::vector<Point>{{0.0, 8.0}, {10.0, 8.0}}, 2, d));
+  auto fine_grids =
+      build_shoreline_index(shorelines, make_grid_bound(0, 0, 10, 10, 1));
+  auto coarse_grids =
+      build_shoreline_index(shorelines, make_grid_bound(0, 0, 10, 10, 5));
+
+  TransectTable transects;
+  transects.push_back(TransectLine(Point{4.5, 0.0}, Point{4.5, 10.0}, 0, 0));
+  build_transect_index(transects, coarse_grids.bound);
+  IntersectTable results;
+  transects[0].intersection(coarse_grids, results);
   ASSERT_EQ(results.size(), 1);
-  EXPECT_NEAR(results[0]->x, 0.0, TOL);
-  EXPECT_NEAR(results[0]->y, 5.0, TOL);
-}
\ No newline at end of file
+  // read as fine cells, the coarse cells (0, 0) and (0, 1) hold no segment
+  transects[0].intersection(fine_grids, results);
+  ASSERT_EQ(results.size(), 2);
+}
+
+TEST_F(TransectTest, test_transect_query_matches_three_step) {
+  // intersect_segment on the query's constants, with offset_at, must agree
+  // with is_intersect + find_intersection + distance2ref
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<double> coord(-10, 10);
+  for (auto orient : {Options::TransectOrientation::Left,
+                      Options::TransectOrientation::Right,
+                      Options::TransectOrientation::Mix}) {
+    TransectLine t(Point{-8.0, -3.0}, Point{7.0, 6.0}, 0, 0,
+                   Options::IntersectionMode::Closest, orient);
+    const auto query = t.query();
+    for (int i = 0; i < 1000; i++) {
+      const Point p(coord(rng), coord(rng)), q(coord(rng), coord(rng));
+      const auto crossing = intersect_segment(query.constants, p, q);
+      ASSERT_EQ(crossing.hit, t.is_intersect(p, q));
+      if (!crossing.hit) continue;
+      const auto point = point_along(query.left(), query.right(), crossing.t);
+      auto expected = t.find_intersection(p, q).value();
+      EXPECT_NEAR(point.x, expected.x, TOL);
+      EXPECT_NEAR(point.y, expected.y, TOL);
+      EXPECT_NEAR(std::abs(query.offset_at(crossing.t)),
+                  t.distance2ref(expected), TOL);
+    }
+  }
+}
+
+TEST_F(TransectTest, test_transect_query_collinear_midpoint) {
+  // ref point = midpoint (5, 0); the overlap's midpoint (3, 0) stands in for
+  // the crossing, 2 towards leftEdge_
+  TransectLine t(Point{0.0, 0.0}, Point{10.0, 0.0}, 0, 0);
+  const auto query = t.query();
+  const auto crossing =
+      intersect_segment(query.constants, Point{2.0, 0.0}, Point{4.0, 0.0});
+  ASSERT_TRUE(crossing.hit);
+  const auto point = point_along(query.left(), query.right(), crossing.t);
+  EXPECT_NEAR(point.x, 3.0, TOL);
+  EXPECT_NEAR(point.y, 0.0, TOL);
+  EXPECT_NEAR(query.offset_at(crossing.t), -2.0, TOL);
+}
+
+TEST_F(TransectTest, test_transect_table_view) {
+  // rows of a TransectTable answer the queries as the lines they came from
+  Date d{2000, 1, 1};
+  std::vector<std::unique_ptr<Shoreline>> shorelines;
+  shorelines.push_back(std::make_unique<Shoreline>(
+      std::vector<Point>{{-5.0, 1.0}, {5.0, 1.0}, {5.0, 3.0}}, 4, d));
+  auto grids =
+      build_shoreline_index(shorelines, make_grid_bound(-5, 0, 5, 10, 1));
+  auto rtree = build_shoreline_rtree(shorelines);
+
+  const TransectLine lines[]{
+      {Point{0.0, 0.0}, Point{0.0, 10.0}, 3, 1,
+       Options::IntersectionMode::Closest, Options::TransectOrientation::Left},
+      {Point{-2.0, 0.0}, Point{4.0, 6.0}, 5, 1}};
+  TransectTable transects;
+  for (const auto &line : lines) transects.push_back(line);
+  build_transect_index(transects, grids.bound);
+  ASSERT_EQ(transects.size(), 2);
+
+  for (size_t i = 0; i < transects.size(); i++) {
+    const auto &line = lines[i];
+    const auto transect = transects[i];
+    EXPECT_EQ(transect.left_edge(), line.leftEdge_);
+    EXPECT_EQ(transect.right_edge(), line.rightEdge_);
+    EXPECT_EQ(transect.ref_point(), line.transect_ref_point_);
+    EXPECT_EQ(transect.base_point(), line.transect_base_point_);
+    EXPECT_EQ(transect.transect_id(), line.transect_id_);
+    EXPECT_FALSE(transect.grid_cells().empty());
+
+    const auto expected = line.intersection(*shorelines[0]);
+    const auto actual = transect.intersection(*shorelines[0]);
+    ASSERT_TRUE(expected.has_value());
+    ASSERT_TRUE(actual.has_value());
+    EXPECT_EQ(actual->distance, expected->distance);
+
+    IntersectTable results;
+    transect.intersection(grids, results);
+    transect.intersection(rtree, results);
+    ASSERT_EQ(results.size(), 2);
+    for (size_t k = 0; k < results.size(); k++) {
+      EXPECT_EQ(results.transect_id[k], line.transect_id_);
+      EXPECT_NEAR(results.distance[k], expected->distance, TOL);
+    }
+  }
+
+  // appending drops the stored cells, which no longer cover every row
+  transects.push_back(lines[0]);
+  EXPECT_TRUE(transects[0].grid_cells().empty());
+  transects.clear();
+  EXPECT_TRUE(transects.empty());
+}
+
+TEST_F(TransectTest, test_transect_table_mode) {
+  // the table takes the mode of its lines and refuses to mix them
+  const TransectLine closest{Point{0.0, 0.0}, Point{0.0, 10.0}, 0, 0,
+                             Options::IntersectionMode::Closest};
+  const TransectLine farthest{Point{1.0, 0.0}, Point{1.0, 10.0}, 1, 0,
+                              Options::IntersectionMode::Farthest};
+  TransectTable transects;
+  transects.push_back(farthest);
+  EXPECT_EQ(transects.mode, Options::IntersectionMode::Farthest);
+  EXPECT_EQ(transects.query(0).mode, Options::IntersectionMode::Farthest);
+  ASSERT_THROW(transects.push_back(closest), std::runtime_error);
+  EXPECT_EQ(transects.size(), 1);
+
+  transects.clear();
+  transects.push_back(closest);
+  EXPECT_EQ(transects.mode, Options::IntersectionMode::Closest);
+}
+
+TEST_F(TransectTest, test_transect_table_append) {
+  // appending tables keeps the rows in order and the rule on modes
+  const TransectLine lines[]{{Point{0.0, 0.0}, Point{0.0, 10.0}, 0, 0},
+                             {Point{1.0, 0.0}, Point{1.0, 10.0}, 1, 0},
+                             {Point{2.0, 0.0}, Point{2.0, 10.0}, 2, 1}};
+  TransectTable first, second, joined;
+  first.push_back(lines[0]);
+  second.push_back(lines[1]);
+  second.push_back(lines[2]);
+  joined.append(TransectTable{});
+  joined.append(first);
+  joined.append(second);
+  ASSERT_EQ(joined.size(), 3);
+  for (size_t i = 0; i < joined.size(); i++) {
+    EXPECT_EQ(joined[i].transect_id(), lines[i].transect_id_);
+    EXPECT_EQ(joined[i].left_edge(), lines[i].leftEdge_);
+    EXPECT_EQ(joined[i].ref_point(), lines[i].transect_ref_point_);
+  }
+  EXPECT_EQ(joined.baseline_id[2], 1);
+
+  TransectTable farthest;
+  farthest.push_back(TransectLine{Point{3.0, 0.0}, Point{3.0, 10.0}, 3, 1,
+                                  Options::IntersectionMode::Farthest});
+  ASSERT_THROW(joined.append(farthest), std::runtime_error);
+  EXPECT_EQ(joined.size(), 3);
+}
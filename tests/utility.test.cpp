@@ -4,7 +4,9 @@
 
 #include "utility.hpp"
 
+#include <cstdint>
 #include <fstream>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -48,6 +50,16 @@ TEST(UtilityTest, TestLeastSquareZeroVariance) {
   ASSERT_NEAR(least_square({5, 5, 5}, {1.0, 2.0, 3.0}), -999.99, TOL);
 }
 
+TEST(UtilityTest, TestLeastSquareDays) {
+  // the day-number overload gives bit-identical slopes
+  const std::vector<std::int32_t> days{2451545, 2455198, 2458850, 2460000};
+  const std::vector<double> distances{0.5, 1.25, 2.0, 4.5};
+  const std::vector<long long> wide(days.begin(), days.end());
+  ASSERT_EQ(least_square(days.data(), distances.data(), days.size()),
+            least_square(wide, distances));
+  ASSERT_NEAR(least_square(days.data(), distances.data(), 0), -999.99, TOL);
+}
+
 TEST(UtilityTest, TestIntersectNonIntersecting) {
   // Bounding boxes overlap but segments don't actually cross → false (line 68)
   Point p1{0.0, 0.0}, p2{1.0, 1.0};
@@ -55,6 +67,14 @@ TEST(UtilityTest, TestIntersectNonIntersecting) {
   ASSERT_FALSE(isTwoSegmentIntersected(p1, p2, p3, p4));
 }
 
+TEST(UtilityTest, TestIntersectTinyCoordinates) {
+  // orientations near 1e-180, whose products underflow to zero
+  const double u = 1e-90;
+  Point p1{0.0, 0.0}, p2{4 * u, 4 * u};
+  ASSERT_FALSE(isTwoSegmentIntersected(p1, p2, {u, 2 * u}, {2 * u, 3.5 * u}));
+  ASSERT_TRUE(isTwoSegmentIntersected(p1, p2, {u, 3 * u}, {3 * u, u}));
+}
+
 TEST(UtilityTest, TestComputeIntersectParallel) {
   // Parallel horizontal lines → d ≈ 0 → returns false (lines 86-87)
   Point p1{0.0, 0.0}, p2{1.0, 0.0}, p3{0.0, 1.0}, p4{1.0, 1.0};
@@ -84,3 +104,15 @@ TEST(UtilityTest, TestGetShpProj) {
     ASSERT_THROW(get_shp_proj(tmp.string().c_str()), std::runtime_error);
   }
 }
+
+TEST(UtilityTest, TestComputeIntersectParallelSilent) {
+  // the degenerate case is counted instead of printed
+  Point p1{0.0, 0.0}, p2{2.0, 0.0}, p3{1.0, 0.0}, p4{3.0, 0.0};
+  Point output;
+  diagnostics.reset();
+  testing::internal::CaptureStdout();
+  ASSERT_FALSE(computeIntersectPoint(p1, p2, p3, p4, output));
+  ASSERT_TRUE(testing::internal::GetCapturedStdout().empty());
+  ASSERT_EQ(diagnostics.parallel_segments, 1);
+  diagnostics.reset();
+}